@@ -0,0 +1,49 @@
+#ifndef CASE_MAP_HPP
+#define CASE_MAP_HPP
+
+#include <string>
+#include <cstddef>
+#include "StringView.hpp"
+
+// RFC 1459 casemapping: A-Z fold to a-z and "[]\^" fold to "{}|~", so
+// "Nick[1]" and "nick{1}" name the same user.
+inline char ircToLower(char c) {
+    if (c >= 'A' && c <= '^')   // 'A'..'Z' then '[' '\' ']' '^'
+        return static_cast<char>(c + ('a' - 'A'));
+    return c;
+}
+
+// FNV-1a over the casefolded bytes.
+inline size_t ircHash(const StringView& s) {
+    size_t h = static_cast<size_t>(2166136261u);
+    for (size_t i = 0; i < s.size(); ++i) {
+        h ^= static_cast<unsigned char>(ircToLower(s[i]));
+        h *= static_cast<size_t>(16777619u);
+    }
+    return h;
+}
+
+inline bool ircEquals(const StringView& a, const StringView& b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (ircToLower(a[i]) != ircToLower(b[i]))
+            return false;
+    }
+    return true;
+}
+
+inline std::string ircCasefold(const StringView& s) {
+    std::string out(s.data(), s.size());
+    for (size_t i = 0; i < out.size(); ++i)
+        out[i] = ircToLower(out[i]);
+    return out;
+}
+
+// Hash traits for FlatHashMap keyed by IRC names.
+struct IrcNameTraits {
+    static size_t hash(const StringView& s) { return ircHash(s); }
+    static bool equal(const StringView& a, const StringView& b) { return ircEquals(a, b); }
+};
+
+#endif
@@ -1,26 +1,40 @@
 #include "Channel.hpp"
+#include "ObjectPool.hpp"
 
 // Constructors
 Channel::Channel()
-: _name(""), _topic(""), _isInviteOnly(false),
+: _name(""), _nameHash(ircHash(StringView())), _topic(""), _isInviteOnly(false),
   _hasTopicRestriction(false), _userLimit(-1)
 {
 }
 
 Channel::Channel(const std::string& name)
-: _name(name), _topic(""), _isInviteOnly(false),
+: _name(name), _nameHash(ircHash(name)), _topic(""), _isInviteOnly(false),
   _hasTopicRestriction(false), _userLimit(-1)
 {
 }
 
 Channel::~Channel() {}
 
+static ObjectPool<Channel>& channelPool() {
+    static ObjectPool<Channel> pool;
+    return pool;
+}
+
+void* Channel::operator new(size_t size) { return channelPool().allocate(size); }
+void Channel::operator delete(void* p, size_t size) { channelPool().deallocate(p, size); }
+const PoolStats& Channel::poolStats() { return channelPool().stats(); }
+
 // --- Getters
 
 const std::string& Channel::getName() const {
     return _name;
 }
 
+size_t Channel::getNameHash() const {
+    return _nameHash;
+}
+
 const std::string& Channel::getTopic() const {
     return _topic;
 }
@@ -42,52 +56,49 @@ int Channel::getUserLimit() const {
 }
 
 bool Channel::isMember(int fd) const {
-    return _members.find(fd) != _members.end();
+    return _members.contains(fd);
 }
 
 bool Channel::isOperator(int fd) const {
-    std::map<int,bool>::const_iterator it = _members.find(fd);
-    if (it != _members.end())
-        return it->second;
-    return false;
+    const ChannelMember* m = _members.find(fd);
+    return m && m->isOp();
 }
 
 bool Channel::isInvited(int fd) const {
-    return _invited.find(fd) != _invited.end();
+    return _invited.contains(fd);
 }
 
 
 // --- Member operations
 
-void Channel::addMember(int fd, bool isOp) {
-    _members[fd] = isOp;
+void Channel::addMember(Client* client, bool isOp) {
+    if (!client || isMember(client->getFd())) return;
+    _members.insert(client->getFd(), ChannelMember(client, isOp ? ChannelMember::OP : 0));
+    client->joinedChannel(this);
 }
 
 void Channel::addClient(Client* client) {
-    if (client)
-        addMember(client->getFd(), false);
+    addMember(client, false);
 }
 
 void Channel::removeMember(int fd, ClientManager* client_manager, bool notify) {
-    _members.erase(fd);
+    ChannelMember* leaving = _members.find(fd);
+    if (leaving) {
+        leaving->client->leftChannel(this);
+        _members.erase(fd);
+    }
     _invited.erase(fd);
-    if(!notify) return;
-    std::map<int,bool>& rem2 = _members;
-		bool hasOp2 = false;
-		for (std::map<int,bool>::const_iterator mit = rem2.begin(); mit != rem2.end(); ++mit) {
-			if (mit->second) { hasOp2 = true; break; }
-		}
-		if (!hasOp2 && !rem2.empty()) {
-			int promoteFd2 = rem2.begin()->first;
-			setOperator(promoteFd2, true);
-			if (client_manager) {
-				Client* promoted2 = client_manager->getClientByFd(promoteFd2);
-				if (promoted2) {
-					std::string modeMsg2 = ":localhost MODE " + _name + " +o " + promoted2->getNick() + "\r\n";
-					broadcast(modeMsg2, client_manager, -1);
-				}
-			}
-		}
+    if (!notify || _members.empty())
+        return;
+    // Keep the channel manageable: promote a member if no operator is left
+    for (size_t i = 0; i < _members.size(); ++i) {
+        if (_members.valueAt(i).isOp())
+            return;
+    }
+    ChannelMember& promoted = _members.valueAt(0);
+    promoted.flags |= ChannelMember::OP;
+    std::string modeMsg = ":localhost MODE " + _name + " +o " + promoted.client->getNick() + "\r\n";
+    broadcast(modeMsg, client_manager, -1);
 }
 
 std::string Channel::getModeString() const {
@@ -114,7 +125,7 @@ std::string Channel::getModeString() const {
     return modes + params.str();
 }
 
-std::map<int,bool>& Channel::getMembers() {
+const MemberTable& Channel::getMembers() const {
     return _members;
 }
 
@@ -130,9 +141,12 @@ void Channel::setKey(const std::string& key) {
 }
 
 void Channel::setOperator(int fd, bool isOp) {
-    std::map<int,bool>::iterator it = _members.find(fd);
-    if (it != _members.end())
-        it->second = isOp;
+    ChannelMember* m = _members.find(fd);
+    if (!m) return;
+    if (isOp)
+        m->flags |= ChannelMember::OP;
+    else
+        m->flags &= ~ChannelMember::OP;
 }
 
 
@@ -154,7 +168,7 @@ void Channel::setUserLimit(int limit) {
 // --- Invite
 
 void Channel::inviteUser(int fd) {
-    _invited.insert(fd);
+    _invited.insert(fd, 1);
 }
 
 void Channel::clearInvite(int fd) {
@@ -162,12 +176,13 @@ void Channel::clearInvite(int fd) {
 }
 
 void Channel::broadcast(const std::string& msg, ClientManager* cm, int exceptFd) const {
-    if (!cm) return;
-    for (std::map<int,bool>::const_iterator it = _members.begin(); it != _members.end(); ++it) {
-        int memberFd = it->first;
-        if (exceptFd >= 0 && memberFd == exceptFd) continue;
-        Client* c = cm->getClientByFd(memberFd);
-        if (!c) continue;
-        send(c->getFd(), msg.c_str(), msg.size(), 0);
+    broadcast(MessageRef(msg), cm, exceptFd);
+}
+
+void Channel::broadcast(const MessageRef& msg, ClientManager* cm, int exceptFd) const {
+    (void)cm;
+    for (size_t i = 0; i < _members.size(); ++i) {
+        if (_members.fdAt(i) == exceptFd) continue;
+        _members.valueAt(i).client->queueSend(msg);
     }
 }
@@ -2,20 +2,40 @@
 #define CHANNEL_HPP
 
 #include <string>
-#include <map>
 #include "Client.hpp"
 #include "ClientManager.hpp"
-#include <set>
+#include "FdMap.hpp"
+#include "CaseMap.hpp"
 
 class Client; // forward declaration
 
+// One membership entry: the client and its channel status bits. Members
+// sit packed in an FdMap, so broadcasts walk contiguous memory, lookups by
+// fd are O(1), and a channel's footprint follows its member count rather
+// than the highest fd among them.
+struct ChannelMember {
+    enum { OP = 1, VOICE = 2 };
+
+    Client*         client;
+    unsigned char   flags;
+
+    ChannelMember() : client(NULL), flags(0) {}
+    ChannelMember(Client* c, unsigned char f) : client(c), flags(f) {}
+
+    bool isOp() const { return (flags & OP) != 0; }
+    bool hasVoice() const { return (flags & VOICE) != 0; }
+};
+
+typedef FdMap<ChannelMember> MemberTable;
+
 class Channel {
 private:
     std::string             _name;
+    size_t                  _nameHash;    // ircHash(_name), the table key hash
     std::string             _key;
     std::string             _topic;
-    std::map<int, bool>     _members;     // fd -> isOperator
-    std::set<int>           _invited;     // fds allowed to join
+    MemberTable             _members;     // fd -> client + status flags
+    FdMap<char>             _invited;     // fds allowed to join
 
     bool                    _isInviteOnly;
     bool                    _hasTopicRestriction;
@@ -27,8 +47,14 @@ public:
     Channel(const std::string& name);
     ~Channel();
 
+    // Storage comes from a slab pool (ObjectPool.hpp)
+    static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
+    static const PoolStats& poolStats();
+
     // Basic getters
     const std::string& getName() const;
+    size_t getNameHash() const;
     const std::string& getTopic() const;
     const std::string& getKey() const;
 
@@ -41,11 +67,11 @@ public:
     bool isOperator(int fd) const;
     bool isInvited(int fd) const;
 
-    // Member operations
-    void addMember(int fd, bool isOp);
+    // Member operations (also maintain the client's channel list)
+    void addMember(Client* client, bool isOp);
     void addClient(Client* client); // convenience method
     void removeMember(int fd, ClientManager* client_manager, bool notify);
-    std::map<int,bool>& getMembers();
+    const MemberTable& getMembers() const;
 
     // Topic
     void setTopic(const std::string& topic);
@@ -61,7 +87,9 @@ public:
     void inviteUser(int fd);
     void clearInvite(int fd);
     // Broadcast a raw message to channel members. If exceptFd >= 0, that member will be skipped.
+    // The line is formatted once and shared by every recipient's output queue.
     void broadcast(const std::string& msg, class ClientManager* cm, int exceptFd = -1) const;
+    void broadcast(const MessageRef& msg, class ClientManager* cm, int exceptFd = -1) const;
 };
 
 #endif
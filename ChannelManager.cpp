@@ -4,9 +4,9 @@ ChannelManager::ChannelManager() {}
 
 ChannelManager::~ChannelManager() {
     // Clean up all channel objects
-    std::map<std::string, Channel*>::iterator it = _channels.begin();
-    for (it = _channels.begin(); it != _channels.end(); ++it) {
-        delete it->second;
+    for (size_t i = 0; i < _channels.slotCount(); ++i) {
+        if (_channels.isFull(i))
+            delete _channels.valueAt(i);
     }
     _channels.clear();
 }
@@ -15,33 +15,42 @@ ChannelManager::~ChannelManager() {
 
 void ChannelManager::addChannel(Channel* channel) {
     if (channel)
-        _channels[channel->getName()] = channel;
+        _channels.insertHashed(channel->getName(), channel, channel->getNameHash());
 }
 
-void ChannelManager::removeChannel(const std::string& name) {
-    std::map<std::string, Channel*>::iterator it = _channels.find(name);
-    if (it != _channels.end()) {
-        delete it->second;
-        _channels.erase(it);
+void ChannelManager::removeChannel(const StringView& name) {
+    size_t h = ircHash(name);
+    Channel** slot = _channels.findHashed(name, h);
+    if (slot) {
+        delete *slot;
+        _channels.eraseHashed(name, h);
     }
 }
 
 // --- Search
 
-Channel* ChannelManager::getChannel(const std::string& name) {
-    std::map<std::string, Channel*>::iterator it = _channels.find(name);
-    if (it != _channels.end())
-        return it->second;
-    return NULL;
+Channel* ChannelManager::getChannel(const StringView& name) {
+    Channel** slot = _channels.find(name);
+    return slot ? *slot : NULL;
 }
 
-bool ChannelManager::channelExists(const std::string& name) const {
-    return _channels.find(name) != _channels.end();
+bool ChannelManager::channelExists(const StringView& name) const {
+    return _channels.find(name) != NULL;
+}
+
+Channel* ChannelManager::getOrCreateChannel(const StringView& name, bool& created) {
+    size_t h = ircHash(name);
+    Channel** slot = _channels.findHashed(name, h);
+    created = (slot == NULL);
+    if (slot)
+        return *slot;
+    Channel* channel = new Channel(name.str());
+    _channels.insertHashed(channel->getName(), channel, h);
+    return channel;
 }
 
 // --- Utilities
 
-std::map<std::string, Channel*>& ChannelManager::getAllChannels() {
+ChannelTable& ChannelManager::getAllChannels() {
     return _channels;
 }
-
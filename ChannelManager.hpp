@@ -1,13 +1,18 @@
 #ifndef CHANNEL_MANAGER_HPP
 #define CHANNEL_MANAGER_HPP
 
-#include <map>
 #include <string>
 #include "Channel.hpp"
+#include "FlatHashMap.hpp"
+#include "CaseMap.hpp"
+
+// Channels keyed by RFC 1459-casemapped name: "#Foo" and "#foo" are the
+// same channel, which keeps the spelling it was created with.
+typedef FlatHashMap<std::string, Channel*, IrcNameTraits> ChannelTable;
 
 class ChannelManager {
 private:
-    std::map<std::string, Channel*> _channels; // name -> Channel*
+    ChannelTable _channels; // name -> Channel*, hashed with Channel::getNameHash
 
 public:
     ChannelManager();
@@ -15,15 +20,18 @@ public:
 
     // Add / remove channel
     void addChannel(Channel* channel);
-    void removeChannel(const std::string& name);
+    void removeChannel(const StringView& name);
 
     // Search
-    Channel* getChannel(const std::string& name);
-    bool channelExists(const std::string& name) const;
+    Channel* getChannel(const StringView& name);
+    bool channelExists(const StringView& name) const;
+
+    // Looks the name up once and creates the channel if it is missing;
+    // created tells the caller which happened.
+    Channel* getOrCreateChannel(const StringView& name, bool& created);
 
     // Iterate
-    std::map<std::string, Channel*>& getAllChannels();
+    ChannelTable& getAllChannels();
 };
 
 #endif
-
@@ -14,65 +14,244 @@
 #include "ChannelManager.hpp"
 #include "ClientManager.hpp"
 #include "ParsedCommand.hpp"
-#include <sstream>
+#include "CommandTable.hpp"
 #include <cctype>
-
-
-Client::Client() : _fd(-1), _registered(false), _hasPass(false) {}
-
-Client::Client(int fd)
-	: _fd(fd), _registered(false), _hasPass(false), _shouldQuit(false) {}
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <sys/uio.h>
+#include "Stats.hpp"
+#include "ObjectPool.hpp"
+#include "Metrics.hpp"
+
+#ifdef IOV_MAX
+# define IRC_IOV_BATCH IOV_MAX
+#else
+# define IRC_IOV_BATCH 1024
+#endif
+
+
+Client::Client()
+	: _fd(-1), _registered(false), _hasPass(false), _shouldQuit(false),
+	  _flushScheduled(false), _writeArmed(false), _readPaused(false), _sendQExceeded(false),
+	  _manager(NULL), _owner(0), _fanoutStamp(0), _prefixValid(false), _recvBuffer(RECV_BUFFER_SIZE, MAX_LINE), _heldCost(0), _floodHolds(0), _lastActivity(monotonicNanos()), _sendQueued(0), _writeHead(0), _writeOffset(0), _written(0), _writeCalls(0) {}
+
+Client::Client(int fd, size_t recvQ, size_t lineMax)
+	: _fd(fd), _registered(false), _hasPass(false), _shouldQuit(false),
+	  _flushScheduled(false), _writeArmed(false), _readPaused(false), _sendQExceeded(false),
+	  _manager(NULL), _owner(0), _fanoutStamp(0), _prefixValid(false), _recvBuffer(recvQ, lineMax), _heldCost(0), _floodHolds(0), _lastActivity(monotonicNanos()), _sendQueued(0), _writeHead(0), _writeOffset(0), _written(0), _writeCalls(0) {}
 
 Client::~Client() {
 	if (_fd != -1)
 		close(_fd);
 }
 
+static ObjectPool<Client>& clientPool() {
+	static ObjectPool<Client> pool;
+	return pool;
+}
+
+void* Client::operator new(size_t size) { return clientPool().allocate(size); }
+void Client::operator delete(void* p, size_t size) { clientPool().deallocate(p, size); }
+const PoolStats& Client::poolStats() { return clientPool().stats(); }
+
 // --- Getters
 int Client::getFd() const { return _fd; }
 const std::string& Client::getNick() const { return _nickname; }
 const std::string& Client::getUser() const { return _username; }
 const std::string& Client::getRealName() const { return _realname; }
 const std::string& Client::getHost() const { return _hostname; }
+const std::string& Client::getPrefix() const {
+	if (!_prefixValid) {
+		_prefix = ":" + (_nickname.empty() ? std::string("*") : _nickname) + "!" + _username + "@" + _hostname;
+		_prefixValid = true;
+	}
+	return _prefix;
+}
+const std::vector<Channel*>& Client::getChannels() const { return _channels; }
 bool Client::isRegistered() const { return _registered; }
 bool Client::hasPass() const { return _hasPass; }
 
 // --- Setters
-void Client::setNick(const std::string& nick) { _nickname = nick; }
-void Client::setUser(const std::string& user) { _username = user; }
+void Client::setNick(const std::string& nick) {
+	std::string oldNick = _nickname;
+	_nickname = nick;
+	_prefixValid = false;
+	if (_manager)
+		_manager->renameClient(this, oldNick);
+}
+void Client::setUser(const std::string& user) { _username = user; _prefixValid = false; }
 void Client::setRealName(const std::string& name) { _realname = name; }
-void Client::setHost(const std::string& host) { _hostname = host; }
+void Client::setHost(const std::string& host) { _hostname = host; _prefixValid = false; }
 void Client::setPass(bool status) { _hasPass = status; }
 void Client::setRegistered(bool status) { _registered = status; }
 
 // --- Buffer logic
-void Client::appendToRecv(const std::string& data) {
-	_recvBuffer += data;
+size_t Client::appendToRecv(const char* data, size_t len) {
+	return _recvBuffer.append(data, len);
 }
 
-const std::string& Client::getRecvBuffer() const {
+RecvBuffer& Client::getRecvBuffer() {
 	return _recvBuffer;
 }
 
-bool Client::hasCompleteMessage() const {
-	return (_recvBuffer.find("\r\n") != std::string::npos);
+// Also reports lines the buffer dropped for exceeding the length limit.
+bool Client::hasCompleteMessage() {
+	bool found = _recvBuffer.hasLine();
+	for (unsigned n = _recvBuffer.takeOverflows(); n > 0; --n) {
+		std::string err = ":localhost 417 " + (_nickname.empty() ? std::string("*") : _nickname) + " :Input line was too long\r\n";
+		queueSend(err);
+	}
+	return found;
 }
 
-std::string Client::popMessage() {
-	size_t pos = _recvBuffer.find("\r\n");
-	std::string msg = _recvBuffer.substr(0, pos);
-	_recvBuffer.erase(0, pos + 2);
-	return msg;
+StringView Client::popMessage() {
+	return _recvBuffer.popLine();
 }
 
+void Client::setManager(ClientManager* manager) {
+	_manager = manager;
+}
+
+// Appends to the output queue; the server loop writes it out once the
+// current batch of events has been handled. A client whose backlog grows
+// past the configured limit is dropped instead of buffering without bound.
 void Client::queueSend(const std::string& msg) {
-	_sendBuffer += msg;
+	queueSend(MessageRef(msg));
 }
 
-std::string Client::flushSend() {
-	std::string tmp = _sendBuffer;
-	_sendBuffer.clear();
-	return tmp;
+void Client::queueSend(const MessageRef& msg) {
+	if (_sendQExceeded || _fd == -1 || msg.empty())
+		return;
+	if (_manager && _sendQueued + msg.size() > _manager->getSendQLimit()) {
+		// The write queue may be in use by the owner; it is settled as usual
+		_sendQExceeded = true;
+		for (size_t i = 0; i < _sendQueue.size(); ++i)
+			_sendQueued -= _sendQueue[i].size();
+		_sendQueue.clear();
+		markForQuit("SendQ exceeded");
+		return;
+	}
+	_sendQueue.push_back(msg);
+	_sendQueued += msg.size();
+	if (!_flushScheduled && _manager) {
+		_flushScheduled = true;
+		_manager->scheduleFlush(_fd);
+	}
+}
+
+// Takes, writes and settles in one go, for callers already holding the
+// state lock (connection teardown, shutdown).
+Client::FlushResult Client::flushSend() {
+	takeOutput();
+	FlushResult res = writeOutput();
+	settleOutput();
+	return res;
+}
+
+// State lock held: moves everything queued so far behind the write queue
+// and allows the next queueSend() to schedule a flush again.
+bool Client::takeOutput() {
+	_flushScheduled = false;
+	if (_writeQueue.empty())
+		_writeQueue.swap(_sendQueue);
+	else {
+		_writeQueue.insert(_writeQueue.end(), _sendQueue.begin(), _sendQueue.end());
+		_sendQueue.clear();
+	}
+	return _writeHead < _writeQueue.size();
+}
+
+// Owner only, no lock needed: writes the taken queue with writev() over
+// batches of up to IOV_MAX blocks, advancing the write cursor. Nothing is
+// released here; a partial write leaves the cursor inside an entry.
+Client::FlushResult Client::writeOutput() {
+	struct iovec iov[IRC_IOV_BATCH];
+	while (_writeHead < _writeQueue.size()) {
+		int count = 0;
+		size_t total = 0;
+		for (std::deque<MessageRef>::const_iterator it = _writeQueue.begin() + _writeHead;
+			it != _writeQueue.end() && count < IRC_IOV_BATCH; ++it, ++count) {
+			size_t skip = (count == 0) ? _writeOffset : 0;
+			iov[count].iov_base = const_cast<char*>(it->data() + skip);
+			iov[count].iov_len = it->size() - skip;
+			total += iov[count].iov_len;
+		}
+		ssize_t n = writev(_fd, iov, count);
+		++_writeCalls;
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return FLUSH_PENDING;
+			return FLUSH_ERROR;
+		}
+		size_t written = static_cast<size_t>(n);
+		_written += written;
+		while (written > 0) {
+			size_t left = _writeQueue[_writeHead].size() - _writeOffset;
+			if (written < left) {
+				_writeOffset += written;
+				break;
+			}
+			written -= left;
+			++_writeHead;
+			_writeOffset = 0;
+		}
+		if (static_cast<size_t>(n) < total)
+			return FLUSH_PENDING; // short write: the socket buffer is full
+	}
+	return FLUSH_DONE;
+}
+
+// State lock held: releases the entries written since the last settle and
+// accounts for them.
+void Client::settleOutput() {
+	ServerStats& stats = serverStats();
+	stats.writeCalls += _writeCalls;
+	stats.bytesOut += _written;
+	stats.messagesOut += _writeHead;
+	_sendQueued -= _written;
+	_writeQueue.erase(_writeQueue.begin(), _writeQueue.begin() + _writeHead);
+	_writeHead = 0;
+	_written = 0;
+	_writeCalls = 0;
+}
+
+bool Client::hasPendingOutput() const {
+	return !_sendQueue.empty() || !_writeQueue.empty();
+}
+
+size_t Client::pendingOutputSize() const {
+	return _sendQueued;
+}
+
+void Client::clearFlushScheduled() {
+	_flushScheduled = false;
+}
+
+int Client::getOwner() const {
+	return _owner;
+}
+
+void Client::setOwner(int worker) {
+	_owner = worker;
+}
+
+bool Client::isWriteArmed() const {
+	return _writeArmed;
+}
+
+void Client::setWriteArmed(bool armed) {
+	_writeArmed = armed;
+}
+
+bool Client::isReadPaused() const {
+	return _readPaused;
+}
+
+void Client::setReadPaused(bool paused) {
+	_readPaused = paused;
 }
 
 void Client::sendUnknownCommand(const std::string& cmd)
@@ -81,23 +260,24 @@ void Client::sendUnknownCommand(const std::string& cmd)
 					+ _nickname + " " 
 					+ cmd + " :Unknown command\r\n";
 
-	send(_fd, msg.c_str(), msg.size(), 0);
+	queueSend(msg);
 }
 
-void Client::handlePassword(const std::string &pass, ClientManager *client_manager) {
+void Client::handlePassword(const ParsedCommand &cmd, ChannelManager *, ClientManager *client_manager) {
+	std::string pass = cmd.param(0).str();
 	if (!client_manager || pass.empty() || _hasPass)
 	{
 		std::string msg = ":localhost NOTICE * :Password already set or invalid\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
+		queueSend(msg);
 		return;
 	}
 	_hasPass = client_manager->checkPassword(pass);
 	if (_hasPass) {
 		std::string msg = ":localhost NOTICE " + _nickname + " :Password accepted\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
+		queueSend(msg);
 	} else {
 		std::string msg = ":localhost NOTICE " + _nickname + " :Password rejected\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
+		queueSend(msg);
 	}
 }
 
@@ -136,107 +316,94 @@ static bool isValidUser(const std::string &u) {
 	return true;
 }
 
-void Client::handleNick(const std::string &nick, ChannelManager *channel_manager, ClientManager *client_manager) {
-	if (!_hasPass)
-	{
-		std::string msg = ":localhost NOTICE * :You must set password first\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
-	}
+// Free-form text (reasons, messages) may come as a ':' trailing parameter
+// or as bare words; take everything from param i. The parser already drops
+// the ':' of a trailing parameter, so only a bare-word start loses one.
+static std::string freeText(const ParsedCommand &cmd, size_t i) {
+	StringView text = cmd.restFrom(i);
+	bool trailing = cmd.hasTrailing() && i + 1 == cmd.paramCount();
+	if (!trailing && !text.empty() && text[0] == ':')
+		text = text.substr(1);
+	return text.str();
+}
 
+void Client::handleNick(const ParsedCommand &cmd, ChannelManager *, ClientManager *client_manager) {
+
+	std::string nick = cmd.param(0).str();
 	if (nick.empty() || _nickname == nick)
 	{
 		std::string msg = ":localhost NOTICE * :Invalid nickname\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
+		queueSend(msg);
 		return;
 	}
     
 	if (!isValidNick(nick)) {
 		std::string msg = ":localhost 432 * " + nick + " :Erroneous nickname\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
+		queueSend(msg);
 		return;
 	}
 
-	if (client_manager && client_manager->nicknameExists(nick)) {
+	// Nicks compare under RFC 1459 casemapping; changing the case of
+	// one's own nick is allowed.
+	Client* holder = client_manager ? client_manager->getClientByNick(nick) : NULL;
+	if (holder && holder != this) {
 		std::string msg = ":localhost 433 * " + nick + " :Nickname is already in use\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
+		queueSend(msg);
 		return;
 	}
 
+	// :<oldnick>!<user>@<host> NICK :<newnick>, built before the prefix changes
+	MessageRef nickMsg = MessageBuilder(getPrefix()).word("NICK").trailing(nick).build();
 	std::string oldNick = _nickname;
 	_nickname = nick;
-	std::string msg = ":" + oldNick + "!" + _username + "@" + _hostname + " NICK :" + _nickname + "\r\n";
-	send(_fd, msg.c_str(), msg.size(), 0);
-
-	// Broadcast nick change to other clients in the same channels (RFC):
-	// :<oldnick>!<user>@<host> NICK :<newnick>
-	if (!oldNick.empty() && channel_manager) {
-		std::map<std::string, Channel*>& all = channel_manager->getAllChannels();
-		for (std::map<std::string, Channel*>::iterator it = all.begin(); it != all.end(); ++it) {
-			Channel* ch = it->second;
-			if (!ch) continue;
-			if (!ch->isMember(_fd)) continue;
-			std::string nickMsg = ":" + oldNick + "!" + _username + "@" + _hostname + " NICK :" + _nickname + "\r\n";
-			ch->broadcast(nickMsg, client_manager, _fd);
-		}
-	}
+	_prefixValid = false;
+	if (client_manager)
+		client_manager->renameClient(this, oldNick);
+	queueSend(nickMsg);
+
+	// Broadcast nick change to other clients in the same channels
+	if (!oldNick.empty())
+		sendToCommonPeers(nickMsg, false);
 
 	// If username already set, registering is complete
 	if (!_username.empty())
 		_registered = true;
 }
 
-void Client::handleUser(const std::string &params, ClientManager *client_manager) {
+void Client::handleUser(const ParsedCommand &cmd, ChannelManager *, ClientManager *client_manager) {
 	// Expected params format: <username> <mode> <unused> :<realname>
 	// Example: "ayoub 0 * :Ayoub Ogbi"
-	if (!_hasPass)
-	{
-		std::string msg = ":localhost NOTICE * :You must set password first\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
-	}
 
-	if (params.empty() || _registered)
+	if (_registered)
 	{
 		std::string msg = ":localhost NOTICE * :You are already registered\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
+		queueSend(msg);
 		return;
 	}
 
-	// Parse params: must be exactly 4 parameters and the last must start with ':'
-	std::istringstream iss(params);
-	std::string username, mode, unused;
-	if (!(iss >> username >> mode >> unused)) {
+	// Must be exactly 4 parameters and the last must be the ':' trailing one
+	if (cmd.paramCount() < 3) {
 		std::string msg = ":localhost NOTICE * :Invalid USER format\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
+		queueSend(msg);
 		return; // malformed or missing fields
 	}
-
-	// Now get the realname token which must begin with ':' and may contain spaces
-	std::string realnameToken;
-	if (!(iss >> realnameToken)) {
+	if (cmd.paramCount() < 4) {
 		std::string msg = ":localhost NOTICE * :Invalid USER format (missing realname)\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
+		queueSend(msg);
 		return;
 	}
-	if (realnameToken.empty() || realnameToken[0] != ':') {
+	if (cmd.paramCount() > 4 || !cmd.hasTrailing()) {
 		std::string msg = ":localhost NOTICE * :Invalid USER format (realname must start with ':')\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
+		queueSend(msg);
 		return;
 	}
 
-	std::string rest;
-	std::getline(iss, rest); // remaining part of realname (may contain spaces)
-	if (!rest.empty() && rest[0] == ' ')
-		rest.erase(0, 1);
-	std::string realname = realnameToken.substr(1) + rest;
-
-	if (username.empty())
-		return;
+	std::string username = cmd.param(0).str();
+	std::string realname = cmd.param(3).str();
 
 	if (!isValidUser(username)) {
 		std::string msg = ":localhost NOTICE * :Invalid username\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
+		queueSend(msg);
 		return;
 	}
 
@@ -244,14 +411,15 @@ void Client::handleUser(const std::string &params, ClientManager *client_manager
 	if (client_manager && client_manager->getClientByUser(username))
 	{
 		std::string msg = ":localhost 433 * " + username + " :Username is already in use\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
+		queueSend(msg);
 		return;
 	}
 
 	_username = username;
 	_realname = realname;
+	_prefixValid = false;
 	std::string msg = ":localhost NOTICE " + _nickname + " :User registered\r\n";
-	send(_fd, msg.c_str(), msg.size(), 0);
+	queueSend(msg);
 
 	if (!_nickname.empty())
 	{
@@ -259,370 +427,231 @@ void Client::handleUser(const std::string &params, ClientManager *client_manager
 	}
 }
 
-void Client::handleJoin(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager) {
-	// Must be registered to join
-	if (!channel_manager || params.empty())
-	{
-		std::string msg = ":localhost NOTICE * :Invalid JOIN parameters\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
-	}
-	if (!_hasPass) {
-		std::string msg = ":localhost NOTICE * :You must set password first\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
-	}
-	if (!_registered) {
-		std::string msg = ":localhost NOTICE * :You must be registered to join channels\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
-	}
+// A key travels as a middle parameter of JOIN and MODE replies, so it must
+// be one non-empty word that does not start with ':'.
+static bool isValidKey(const std::string &key) {
+	return !key.empty() && key[0] != ':' && key.find(' ') == std::string::npos;
+}
+
+void Client::handleJoin(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager) {
+	if (!channel_manager) return;
 
 	// Handle special case: 'JOIN 0' => part all channels
-	if (params == "0") {
-		std::map<std::string, Channel*>& all = channel_manager->getAllChannels();
-		for (std::map<std::string, Channel*>::iterator it = all.begin(); it != all.end(); ++it) {
-			Channel* ch = it->second;
-			if (ch && ch->isMember(_fd)) {
-				// Broadcast PART to channel members (include the leaver)
-				std::string prefix = ":" + _nickname + "!" + _username + "@" + _hostname + " ";
-				std::string partMsg = prefix + "PART " + ch->getName() + "\r\n";
-				ch->broadcast(partMsg, client_manager, -1);
-				ch->removeMember(_fd, client_manager, true);
-			}
+	if (cmd.paramCount() == 1 && cmd.param(0) == StringView("0")) {
+		// Walk a copy: removeMember updates _channels
+		std::vector<Channel*> joined(_channels);
+		for (size_t i = 0; i < joined.size(); ++i) {
+			Channel* ch = joined[i];
+			// Broadcast PART to channel members (include the leaver)
+			ch->broadcast(MessageBuilder(getPrefix()).word("PART").word(ch->getName()).build(), client_manager, -1);
+			ch->removeMember(_fd, client_manager, true);
 		}
 		return;
 	}
 
-	// Parse channels and optional keys
-	std::istringstream iss(params);
-	std::string chansToken;
-	if (!(iss >> chansToken)) return;
-	std::string keysToken;
-	if (!(iss >> keysToken)) keysToken = "";
-
-	// Reject if there are extra space-separated tokens beyond channels and optional keys
-	std::string extraToken;
-	if (iss >> extraToken) {
+	// Reject if there are extra parameters beyond channels and optional keys
+	if (cmd.paramCount() > 2) {
 		std::string msg = ":localhost NOTICE " + _nickname + " :Too many parameters for JOIN\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
+		queueSend(msg);
 		return;
 	}
 
-	// split by commas
-	std::vector<std::string> channels;
-	std::vector<std::string> keys;
-	{
-		std::string token;
-		std::istringstream cs(chansToken);
-		while (std::getline(cs, token, ',')) {
-			if (!token.empty()) channels.push_back(token);
-		}
-	}
-	if (!keysToken.empty()) {
-		std::string token;
-		std::istringstream ks(keysToken);
-		while (std::getline(ks, token, ',')) {
-			keys.push_back(token);
-		}
-	}
-
 	// Keys may be fewer than channels; missing keys are treated as empty (no key provided).
 	// A provided key is applied positionally to the corresponding channel.
-
-	for (size_t i = 0; i < channels.size(); ++i) {
-		std::string chName = channels[i];
+	ListSplitter channels(cmd.param(0));
+	ListSplitter keys(cmd.param(1));
+	StringView chField;
+	while (channels.next(chField)) {
+		StringView keyField;
+		if (!keys.next(keyField))
+			keyField = StringView();
+		if (chField.empty()) continue;
+		std::string chName = chField.str();
 		// basic validation: channel must start with '#'
-		if (chName.empty() || chName[0] != '#') {
+		if (chName[0] != '#') {
 			std::string msg = ":localhost NOTICE " + _nickname + " :Invalid channel name " + chName + "\r\n";
-			send(_fd, msg.c_str(), msg.size(), 0);
+			queueSend(msg);
 			continue;
 		}
 		bool isOp = false;
-		Channel* ch = NULL;
-		if (!channel_manager->channelExists(chName)) {
-			ch = new Channel(chName);
-			channel_manager->addChannel(ch);
-			isOp = true;
-		} else {
-			ch = channel_manager->getChannel(chName);
-		}
-
-		if (!ch) continue;
+		Channel* ch = channel_manager->getOrCreateChannel(chField, isOp);
+		// Replies use the name the channel was created with
+		chName = ch->getName();
 
 		if (ch->isMember(_fd)) continue; // already in
 
 		// Determine provided key (if any)
-		std::string providedKey = (i < keys.size() ? keys[i] : "");
+		std::string providedKey = keyField.str();
 
-		// If channel newly created and a key was provided, set it
+		// If channel newly created and a key was provided, set it. A malformed
+		// key is refused as in MODE +k and the channel is created without one.
 		if (ch->getKey().empty() && !providedKey.empty() && isOp) {
-			ch->setKey(providedKey);
+			if (isValidKey(providedKey))
+				ch->setKey(providedKey);
+			else
+				queueSend(":localhost 525 " + _nickname + " " + chName + " :Key is not well-formed\r\n");
 		}
 
 		// If channel has a key and provided key doesn't match -> ERR_BADCHANNELKEY (475)
 		if (!ch->getKey().empty() && ch->getKey() != providedKey) {
 			std::string msg = ":localhost 475 " + _nickname + " " + chName + " :Cannot join channel (+k)\r\n";
-			send(_fd, msg.c_str(), msg.size(), 0);
+			queueSend(msg);
 			continue;
 		}
 		// If channel is invite-only and client not invited -> ERR_INVITEONLYCHAN (473)
 		if (ch->isInviteOnly() && !ch->isInvited(_fd))
 		{
 			std::string msg = ":localhost 473 " + _nickname + " " + chName + " :Cannot join channel (+i)\r\n";
-			send(_fd, msg.c_str(), msg.size(), 0);
+			queueSend(msg);
 			continue;
 		}
 		if( ch->getUserLimit() > 0 && static_cast<int>(ch->getMembers().size()) >= ch->getUserLimit()) {
 			std::string msg = ":localhost 471 " + _nickname + " " + chName + " :Cannot join channel (+l)\r\n";
-			send(_fd, msg.c_str(), msg.size(), 0);
+			queueSend(msg);
 			continue;
 		}
 		// Add member to channel
-		ch->addMember(_fd, isOp);
+		ch->addMember(this, isOp);
 
 			// Broadcast JOIN to all members (including the joiner)
-			std::string prefix = ":" + _nickname + "!" + _username + "@" + _hostname + " ";
-			std::string joinMsg = prefix + "JOIN " + chName + "\r\n";
-			ch->broadcast(joinMsg, client_manager, -1);
-			std::map<int,bool>& members = ch->getMembers();
+			ch->broadcast(MessageBuilder(getPrefix()).word("JOIN").word(chName).build(), client_manager, -1);
+			const MemberTable& members = ch->getMembers();
 
 		// Send TOPIC (332) to the joiner
 		std::string topicMsg = ":localhost 332 " + _nickname + " " + chName + " :" + ch->getTopic() + "\r\n";
-		send(_fd, topicMsg.c_str(), topicMsg.size(), 0);
+		queueSend(topicMsg);
 
 		// Send NAMES (353) and end (366)
 		std::string namesList;
-		for (std::map<int,bool>::const_iterator mit = members.begin(); mit != members.end(); ++mit) {
-			Client* memberClient = NULL;
-			if (client_manager) memberClient = client_manager->getClientByFd(mit->first);
-			if (memberClient) {
-				if (!namesList.empty()) namesList += " ";
-				namesList += memberClient->getNick();
-			}
+		for (size_t m = 0; m < members.size(); ++m) {
+			if (!namesList.empty()) namesList += " ";
+			namesList += members.valueAt(m).client->getNick();
 		}
 		std::string namesMsg = ":localhost 353 " + _nickname + " = " + chName + " :" + namesList + "\r\n";
-		send(_fd, namesMsg.c_str(), namesMsg.size(), 0);
+		queueSend(namesMsg);
 		std::string endNames = ":localhost 366 " + _nickname + " " + chName + " :End of /NAMES list.\r\n";
-		send(_fd, endNames.c_str(), endNames.size(), 0);
+		queueSend(endNames);
 	}
 }
 
-void Client::handlePart(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager) {
+void Client::handlePart(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager) {
 	if (!channel_manager) return;
-	if (params.empty()) return;
-
-	// Parse channels list and optional reason
-	std::istringstream iss(params);
-	std::string chansToken;
-	if (!(iss >> chansToken)) return;
-
-	std::string reason;
-	std::string reasonToken;
-	if (iss >> reasonToken) {
-		if (!reasonToken.empty() && reasonToken[0] == ':') {
-			reason = reasonToken.substr(1);
-			std::string rest;
-			std::getline(iss, rest);
-			if (!rest.empty()) {
-				if (rest[0] == ' ') rest.erase(0, 1);
-				reason += rest;
-			}
-		} else {
-			reason = reasonToken;
-			std::string rest;
-			std::getline(iss, rest);
-			if (!rest.empty()) {
-				if (rest[0] == ' ') rest.erase(0, 1);
-				reason += rest;
-			}
-		}
-	}
+
+	// Channels list and optional reason
+	std::string reason = freeText(cmd, 1);
 
 	// Split channel list by comma and part each
-	std::istringstream cs(chansToken);
-	std::string chName;
-	while (std::getline(cs, chName, ',')) {
-		if (chName.empty()) continue;
-		Channel* ch = channel_manager->getChannel(chName);
+	ListSplitter channels(cmd.param(0));
+	StringView chField;
+	while (channels.next(chField)) {
+		if (chField.empty()) continue;
+		Channel* ch = channel_manager->getChannel(chField);
 		if (!ch) continue;
 		if (!ch->isMember(_fd)) continue;
 
 		// Broadcast PART to all members (including the leaver)
-		std::string prefix = ":" + _nickname + "!" + _username + "@" + _hostname + " ";
-		std::string partMsg = prefix + "PART " + ch->getName();
-		if (!reason.empty()) partMsg += " :" + reason;
-		partMsg += "\r\n";
-		ch->broadcast(partMsg, client_manager, -1);
+		MessageBuilder partMsg(getPrefix());
+		partMsg.word("PART").word(ch->getName());
+		if (!reason.empty()) partMsg.trailing(reason);
+		ch->broadcast(partMsg.build(), client_manager, -1);
 		ch->removeMember(_fd, client_manager, true);
 	}
 }
 
-// removed old single-arg overload; new implementation below
-
-void Client::handlePrivateMessage(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager) {
+void Client::handlePrivateMessage(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager) {
 	// PRIVMSG <target>{,<target>} :<message>
-	if (!_hasPass)
-	{
-		std::string msg = ":localhost NOTICE * :You must set password first\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
-	}
-	if (!_registered) {
-		std::string msg = ":localhost NOTICE * :You must be registered to send messages\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
-	}
-	if (params.empty()) return;
-
-	std::istringstream iss(params);
-	std::string targetsToken;
-	if (!(iss >> targetsToken)) return;
-
-	// Extract message (rest of the line). It may start with ':'
-	std::string msgToken;
-	std::string message;
-	if (std::getline(iss, msgToken)) {
-		if (!msgToken.empty() && msgToken[0] == ' ') msgToken.erase(0, 1);
-		if (!msgToken.empty() && msgToken[0] == ':') message = msgToken.substr(1);
-		else message = msgToken;
-	}
+
+	// Message is the rest of the line. It may start with ':'
+	std::string message = freeText(cmd, 1);
 
 	if (message.empty()) {
 		// ERR_NOTEXTTOSEND (412)
 		std::string err = ":localhost 412 ";
 		err += (_nickname.empty() ? "*" : _nickname) + " :No text to send\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
+		queueSend(err);
 		return;
 	}
 
 	// split targets by comma
-	std::istringstream ts(targetsToken);
-	std::string target;
-	while (std::getline(ts, target, ',')) {
-		if (target.empty()) continue;
+	ListSplitter targets(cmd.param(0));
+	StringView targetField;
+	while (targets.next(targetField)) {
+		if (targetField.empty()) continue;
+		std::string target = targetField.str();
 
 		if (target[0] == '#') {
 			// Channel target
 			if (!channel_manager) continue;
-			Channel* ch = channel_manager->getChannel(target);
+			Channel* ch = channel_manager->getChannel(targetField);
 			if (!ch) {
 				// No such channel
 				std::string err = ":localhost 401 ";
 				err += (_nickname.empty() ? "*" : _nickname) + " " + target + " :No such nick/channel\r\n";
-				send(_fd, err.c_str(), err.size(), 0);
+				queueSend(err);
 				continue;
 			}
 			if (!ch->isMember(_fd)) {
 				// Cannot send to channel (not a member)
 				std::string err = ":localhost 404 ";
 				err += (_nickname.empty() ? "*" : _nickname) + " " + target + " :Cannot send to channel\r\n";
-				send(_fd, err.c_str(), err.size(), 0);
+				queueSend(err);
 				continue;
 			}
 
 			// Send to all members except sender
-			std::string prefix = ":" + (_nickname.empty() ? std::string("*") : _nickname) + "!" + _username + "@" + _hostname + " ";
-			std::string out = prefix + "PRIVMSG " + target + " :" + message + "\r\n";
-			ch->broadcast(out, client_manager, _fd);
+			ch->broadcast(MessageBuilder(getPrefix()).word("PRIVMSG").word(ch->getName()).trailing(message).build(), client_manager, _fd);
 		} else {
 			// User target
 			if (!client_manager) continue;
-			Client* dest = client_manager->getClientByNick(target);
+			Client* dest = client_manager->getClientByNick(targetField);
 			if (!dest) {
 				std::string err = ":localhost 401 ";
 				err += (_nickname.empty() ? "*" : _nickname) + " " + target + " :No such nick/channel\r\n";
-				send(_fd, err.c_str(), err.size(), 0);
+				queueSend(err);
 				continue;
 			}
 			// Send to the user
-			std::string prefix = ":" + (_nickname.empty() ? std::string("*") : _nickname) + "!" + _username + "@" + _hostname + " ";
-			std::string out = prefix + "PRIVMSG " + target + " :" + message + "\r\n";
-			send(dest->getFd(), out.c_str(), out.size(), 0);
+			dest->queueSend(MessageBuilder(getPrefix()).word("PRIVMSG").word(targetField).trailing(message).build());
 		}
 	}
 }
 
-void Client::handleKick(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager) {
+void Client::handleKick(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager) {
 	// KICK <channel>{,<channel>} <user>{,<user>} [ :<reason>]
-	if (!_hasPass) {
-		std::string msg = ":localhost NOTICE * :You must set password first\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
-	}
-	if (!_registered) {
-		std::string msg = ":localhost NOTICE * :You must be registered to use KICK\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
-	}
-	if (params.empty()) {
-		std::string err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " KICK :Not enough parameters\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
-		return;
-	}
-
-	std::istringstream iss(params);
-	std::string channelsToken, usersToken;
-	if (!(iss >> channelsToken)) return;
-	if (!(iss >> usersToken)) {
-		std::string err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " KICK :Not enough parameters\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
-		return;
-	}
 
 	// optional reason
-	std::string reason;
-	std::string reasonToken;
-	if (iss >> reasonToken) {
-		if (!reasonToken.empty() && reasonToken[0] == ':') {
-			reason = reasonToken.substr(1);
-			std::string rest;
-			std::getline(iss, rest);
-			if (!rest.empty()) {
-				if (rest[0] == ' ') rest.erase(0,1);
-				reason += rest;
-			}
-		} else {
-			reason = reasonToken;
-			std::string rest;
-			std::getline(iss, rest);
-			if (!rest.empty()) {
-				if (rest[0] == ' ') rest.erase(0,1);
-				reason += rest;
-			}
-		}
-	}
+	std::string reason = freeText(cmd, 2);
 
-	// split channels and users
-	std::vector<std::string> channels;
+	// split users; pair channels and users positionally, and if counts
+	// differ, use the last user for the remaining channels
 	std::vector<std::string> users;
 	{
-		std::string token;
-		std::istringstream cs(channelsToken);
-		while (std::getline(cs, token, ',')) if (!token.empty()) channels.push_back(token);
-	}
-	{
-		std::string token;
-		std::istringstream us(usersToken);
-		while (std::getline(us, token, ',')) if (!token.empty()) users.push_back(token);
-	}
-
-	// Pair channels and users positionally; if counts differ, use last user for remaining channels
-	for (size_t i = 0; i < channels.size(); ++i) {
-		std::string chName = channels[i];
+		ListSplitter us(cmd.param(1));
+		StringView field;
+		while (us.next(field)) if (!field.empty()) users.push_back(field.str());
+	}
+	if (users.empty()) return;
+
+	ListSplitter channels(cmd.param(0));
+	StringView chField;
+	size_t i = 0;
+	while (channels.next(chField)) {
+		if (chField.empty()) continue;
+		std::string chName = chField.str();
 		std::string targetNick = (i < users.size() ? users[i] : users.back());
+		++i;
 
 		Channel* ch = channel_manager ? channel_manager->getChannel(chName) : NULL;
 		if (!ch) {
 			std::string err = ":localhost 403 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + chName + " :No such channel\r\n";
-			send(_fd, err.c_str(), err.size(), 0);
+			queueSend(err);
 			continue;
 		}
 
 		// Must be operator to KICK
 		if (!ch->isOperator(_fd)) {
 			std::string err = ":localhost 482 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + chName + " :You're not channel operator\r\n";
-			send(_fd, err.c_str(), err.size(), 0);
+			queueSend(err);
 			continue;
 		}
 
@@ -630,59 +659,38 @@ void Client::handleKick(const std::string &params, ChannelManager *channel_manag
 		Client* target = client_manager ? client_manager->getClientByNick(targetNick) : NULL;
 		if (!target) {
 			std::string err = ":localhost 401 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + targetNick + " :No such nick/channel\r\n";
-			send(_fd, err.c_str(), err.size(), 0);
+			queueSend(err);
 			continue;
 		}
 
 		if (!ch->isMember(target->getFd())) {
 			std::string err = ":localhost 441 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + targetNick + " " + chName + " :They aren't on that channel\r\n";
-			send(_fd, err.c_str(), err.size(), 0);
+			queueSend(err);
 			continue;
 		}
 
 		// Broadcast KICK to all members
-		std::string kickMsgPrefix = ":" + _nickname + "!" + _username + "@" + _hostname + " ";
-		std::string kickLine = kickMsgPrefix + "KICK " + chName + " " + targetNick;
-		if (!reason.empty()) kickLine += " :" + reason;
-		kickLine += "\r\n";
-		ch->broadcast(kickLine, client_manager, -1);
+		MessageBuilder kickLine(getPrefix());
+		kickLine.word("KICK").word(chName).word(targetNick);
+		if (!reason.empty()) kickLine.trailing(reason);
+		ch->broadcast(kickLine.build(), client_manager, -1);
 
 		// Remove target from channel
 		ch->removeMember(target->getFd(), client_manager, false);
 	}
 }
 
-void Client::handleInvite(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager) {
+void Client::handleInvite(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager) {
 	// INVITE <nick> <channel>
-	if (!_hasPass) {
-		std::string msg = ":localhost NOTICE * :You must set password first\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
-	}
-	if (!_registered) {
-		std::string msg = ":localhost NOTICE * :You must be registered to use INVITE\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
-	}
-	if (params.empty()) {
-		std::string err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " INVITE :Not enough parameters\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
-		return;
-	}
 
-	std::istringstream iss(params);
-	std::string targetNick, channelName;
-	if (!(iss >> targetNick >> channelName)) {
-		std::string err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " INVITE :Not enough parameters\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
-		return;
-	}
+	std::string targetNick = cmd.param(0).str();
+	std::string channelName = cmd.param(1).str();
 
 	if (!client_manager) return;
 	Client* target = client_manager->getClientByNick(targetNick);
 	if (!target) {
 		std::string err = ":localhost 401 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + targetNick + " :No such nick/channel\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
+		queueSend(err);
 		return;
 	}
 
@@ -690,21 +698,21 @@ void Client::handleInvite(const std::string &params, ChannelManager *channel_man
 	Channel* ch = channel_manager->getChannel(channelName);
 	if (!ch) {
 		std::string err = ":localhost 403 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + channelName + " :No such channel\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
+		queueSend(err);
 		return;
 	}
 
 	// Inviter must be on the channel
 	if (!ch->isMember(_fd)) {
 		std::string err = ":localhost 442 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + channelName + " :You're not on that channel\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
+		queueSend(err);
 		return;
 	}
 
 	// If target already on channel
 	if (ch->isMember(target->getFd())) {
 		std::string err = ":localhost 443 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + targetNick + " " + channelName + " :is already on channel\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
+		queueSend(err);
 		return;
 	}
 
@@ -712,77 +720,43 @@ void Client::handleInvite(const std::string &params, ChannelManager *channel_man
 	ch->inviteUser(target->getFd());
 
 	// Notify target of invite
-	std::string inviteMsg = ":" + _nickname + "!" + _username + "@" + _hostname + " INVITE " + targetNick + " :" + channelName + "\r\n";
-	send(target->getFd(), inviteMsg.c_str(), inviteMsg.size(), 0);
+	target->queueSend(MessageBuilder(getPrefix()).word("INVITE").word(targetNick).trailing(channelName).build());
 
 	// Send RPL_INVITING (341) to inviter
 	std::string rpl = ":localhost 341 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + targetNick + " " + channelName + "\r\n";
-	send(_fd, rpl.c_str(), rpl.size(), 0);
+	queueSend(rpl);
 }
 
-void Client::handleTopic(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager) {
-	if (!_hasPass) {
-		std::string msg = ":localhost NOTICE * :You must set password first\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
-	}
-	if (!_registered) {
-		std::string msg = ":localhost NOTICE * :You must be registered to use TOPIC\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
-	}
-	if (params.empty()) {
-		std::string err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " TOPIC :Not enough parameters\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
-		return;
-	}
-	std::istringstream iss(params);
-	std::string channelName;
-	if (!(iss >> channelName)) return;
+void Client::handleTopic(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager) {
+	std::string channelName = cmd.param(0).str();
 	Channel* ch = channel_manager ? channel_manager->getChannel(channelName) : NULL;
 	if (!ch) {
 		std::string err = ":localhost 403 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + channelName + " :No such channel\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
+		queueSend(err);
 		return;
 	}
 	if (!ch->isMember(_fd)) {
 		std::string err = ":localhost 442 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + channelName + " :You're not on that channel\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
+		queueSend(err);
 		return;
 	}
 	if (ch->topicRestricted() && !ch->isOperator(_fd)) {
 		std::string err = ":localhost 482 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + channelName + " :You're not channel operator\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
+		queueSend(err);
 		return;
 	}
-	std::string topic;
-	std::string topicToken;
-	std::map<int,bool> members = ch->getMembers();
-	if (iss >> topicToken) {
-		if (!topicToken.empty() && topicToken[0] == ':') {
-			topic = topicToken.substr(1);
-			std::string rest;
-			std::getline(iss, rest);
-			if (topic.empty() && rest.empty()) {
-				//CLEAR TOPIC
-				topic = "";
-				//broadcast cleared topic
-				std::string topicMsg = ":" + _nickname + "!" + _username + "@" + _hostname + " TOPIC " + channelName + " :\r\n";
-				ch->broadcast(topicMsg, client_manager, -1);
-				return;
-			} else if (!rest.empty()) {
-				topic += rest;
-			}
-			//TOPIC TO SET
+	if (cmd.paramCount() >= 2) {
+		if (cmd.paramCount() == 2 && cmd.hasTrailing()) {
+			//TOPIC TO SET (an empty trailing parameter clears it)
+			std::string topic = cmd.param(1).str();
 			ch->setTopic(topic);
 			// Broadcast new topic to all members
-			std::string topicMsg = ":" + _nickname + "!" + _username + "@" + _hostname + " TOPIC " + channelName + " :" + topic + "\r\n";
-			ch->broadcast(topicMsg, client_manager, -1);
+			ch->broadcast(MessageBuilder(getPrefix()).word("TOPIC").word(channelName).trailing(topic).build(), client_manager, -1);
 		}
 		else {
 			//FORMAT ERROR
 			std::string err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " TOPIC :Not enough parameters\r\n";
-			send(_fd, err.c_str(), err.size(), 0);
+			queueSend(err);
 		}
 	}
 	else {
@@ -791,203 +765,214 @@ void Client::handleTopic(const std::string &params, ChannelManager *channel_mana
 		if (currentTopic.empty()) {
 			// No topic is seted
 			std::string noTopicMsg = ":localhost 331 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + channelName + " :No topic is set\r\n";
-			send(_fd, noTopicMsg.c_str(), noTopicMsg.size(), 0);
+			queueSend(noTopicMsg);
 		} else {
 			// Send current topic
 			std::string topicMsg = ":localhost 332 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + channelName + " :" + currentTopic + "\r\n";
-			send(_fd, topicMsg.c_str(), topicMsg.size(), 0);
+			queueSend(topicMsg);
 		}
 	}
 }
 
-
-void Client::handleMode(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager) {
-	if (!_hasPass) {
-		std::string msg = ":localhost NOTICE * :You must set password first\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
-	}
-	if (!_registered) {
-		std::string msg = ":localhost NOTICE * :You must be registered to use TOPIC\r\n";
-		send(_fd, msg.c_str(), msg.size(), 0);
-		return;
+// Parses a non-negative decimal channel limit.
+static bool parseLimit(const StringView &s, int &out) {
+	if (s.empty() || s.size() > 9) return false;
+	int n = 0;
+	for (size_t i = 0; i < s.size(); ++i) {
+		if (s[i] < '0' || s[i] > '9') return false;
+		n = n * 10 + (s[i] - '0');
 	}
-	if (params.empty()) {
-		std::string err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " TOPIC :Not enough parameters\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
-		return;
+	out = n;
+	return true;
+}
+
+// Collects the mode changes applied by one MODE command so the channel
+// sees them as a single line, "+itk-l key" style: one sign per run of
+// same-direction changes, arguments in order. RFC 1459 allows at most
+// three argument-carrying modes per line, so longer batches go out as
+// several lines.
+class ModeChanges {
+public:
+	static const size_t MAX_ARGS = 3;
+
+	ModeChanges() : _sign(0) {}
+
+	// arg must be a single word; handleMode validates keys before they
+	// get here.
+	void add(bool adding, char mode, const std::string &arg = std::string()) {
+		if (!arg.empty() && _current.args.size() == MAX_ARGS) {
+			_lines.push_back(_current);
+			_current = Line();
+			_sign = 0;
+		}
+		char sign = adding ? '+' : '-';
+		if (sign != _sign) {
+			_current.modes += sign;
+			_sign = sign;
+		}
+		_current.modes += mode;
+		if (!arg.empty())
+			_current.args.push_back(arg);
+	}
+
+	// Broadcasts everything collected so far and resets the batch.
+	void flush(Channel *ch, ClientManager *client_manager) {
+		if (!_current.modes.empty())
+			_lines.push_back(_current);
+		for (size_t i = 0; i < _lines.size(); ++i) {
+			MessageBuilder modeLine(":localhost");
+			modeLine.word("MODE").word(ch->getName()).word(_lines[i].modes);
+			for (size_t j = 0; j < _lines[i].args.size(); ++j)
+				modeLine.word(_lines[i].args[j]);
+			ch->broadcast(modeLine.build(), client_manager, -1);
+		}
+		_lines.clear();
+		_current = Line();
+		_sign = 0;
 	}
-	std::istringstream iss(params);
-	std::string channelName;
-	if (!(iss >> channelName)) return;
+
+private:
+	struct Line {
+		std::string modes;
+		std::vector<std::string> args;
+	};
+
+	std::vector<Line> _lines;
+	Line _current;
+	char _sign;
+};
+
+void Client::handleMode(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager) {
+	std::string channelName = cmd.param(0).str();
 	Channel* ch = channel_manager ? channel_manager->getChannel(channelName) : NULL;
 	if (!ch) {
 		std::string err = ":localhost 403 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + channelName + " :No such channel\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
+		queueSend(err);
 		return;
 	}
 	if (!ch->isMember(_fd)) {
 		std::string err = ":localhost 442 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + channelName + " :You're not on that channel\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
+		queueSend(err);
 		return;
 	}
 
 	if (!ch->isOperator(_fd)) {
 		std::string err = ":localhost 482 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + channelName + " :You're not channel operator\r\n";
-		send(_fd, err.c_str(), err.size(), 0);
+		queueSend(err);
 		return;
 	}
 	
-	std::string modeChanges;
-	if (iss >> modeChanges) {
+	if (cmd.paramCount() >= 2) {
+		std::string modeChanges = cmd.param(1).str();
+		size_t nextArg = 2;	// mode arguments follow the mode string
 		bool adding = true;
 		if (modeChanges.empty()) return;
 		if (modeChanges[0] != '+' && modeChanges[0] != '-') {
 			std::string err = ":localhost 472 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + modeChanges + " :is unknown mode character to me\r\n";
-			send(_fd, err.c_str(), err.size(), 0);
+			queueSend(err);
 			return;
 		}
 		else if (modeChanges[0] == '+') adding = true;
 		else if (modeChanges[0] == '-') adding = false;
-		for (size_t i = 1; i < modeChanges.size(); ++i) {
+		// Changes applied before an error still take effect, so they are
+		// announced before the error reply.
+		ModeChanges applied;
+		std::string err;
+		for (size_t i = 1; i < modeChanges.size() && err.empty(); ++i) {
 			char modeChar = modeChanges[i];
 			if (modeChar == 'i') {
 				ch->setInviteOnly(adding);
-				std::string modeMsg = ":localhost MODE " + ch->getName() + " " + (adding ? "+i" : "-i") + "\r\n";
-				ch->broadcast(modeMsg, client_manager, -1);
+				applied.add(adding, 'i');
 			} else if (modeChar == 't') {
 				ch->setTopicRestriction(adding);
-				std::string modeMsg = ":localhost MODE " + ch->getName() + " " + (adding ? "+t" : "-t") + "\r\n";
-				ch->broadcast(modeMsg, client_manager, -1);
+				applied.add(adding, 't');
 			} else if (modeChar == 'k') {
 				// key mode requires an argument when adding
 				if (adding) {
-					std::string key;
-					if (iss >> key) {
-						ch->setKey(key);
-						std::string modeMsg = ":localhost MODE " + ch->getName() + " +k " + key + "\r\n";
-						ch->broadcast(modeMsg, client_manager, -1);
+					if (nextArg < cmd.paramCount()) {
+						std::string key = cmd.param(nextArg++).str();
+						if (!isValidKey(key)) {
+							err = ":localhost 525 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + channelName + " :Key is not well-formed\r\n";
+						} else {
+							ch->setKey(key);
+							applied.add(true, 'k', key);
+						}
 					} else {
-						std::string err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " MODE :Not enough parameters\r\n";
-						send(_fd, err.c_str(), err.size(), 0);
-						return;
+						err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " MODE :Not enough parameters\r\n";
 					}
 				} else {
 					// removing key
 					ch->setKey("");
-					std::string modeMsg = ":localhost MODE " + ch->getName() + " -k\r\n";
-					ch->broadcast(modeMsg, client_manager, -1);
+					applied.add(false, 'k');
 				}
 			} else if (modeChar == 'o') {
 				// operator mode requires a nick argument
-				std::string targetNick;
-				if (iss >> targetNick) {
+				if (nextArg < cmd.paramCount()) {
+					std::string targetNick = cmd.param(nextArg++).str();
 					Client* target = client_manager ? client_manager->getClientByNick(targetNick) : NULL;
 					if (!target) {
-						std::string err = ":localhost 401 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + targetNick + " :No such nick/channel\r\n";
-						send(_fd, err.c_str(), err.size(), 0);
-						return;
-					}
-					if (!ch->isMember(target->getFd())) {
-						std::string err = ":localhost 441 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + targetNick + " " + channelName + " :They aren't on that channel\r\n";
-						send(_fd, err.c_str(), err.size(), 0);
-						return;
+						err = ":localhost 401 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + targetNick + " :No such nick/channel\r\n";
+					} else if (!ch->isMember(target->getFd())) {
+						err = ":localhost 441 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + targetNick + " " + channelName + " :They aren't on that channel\r\n";
+					} else {
+						ch->setOperator(target->getFd(), adding);
+						applied.add(adding, 'o', targetNick);
 					}
-					ch->setOperator(target->getFd(), adding);
-					std::string modeMsg = ":localhost MODE " + ch->getName() + " " + (adding ? "+o " : "-o ") + targetNick + "\r\n";
-					ch->broadcast(modeMsg, client_manager, -1);
 				} else {
-					std::string err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " MODE :Not enough parameters\r\n";
-					send(_fd, err.c_str(), err.size(), 0);
-					return;
+					err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " MODE :Not enough parameters\r\n";
 				}
 			} else if (modeChar == 'l') {
 				// limit mode requires a number argument when adding
 				if (adding) {
-					std::string limitStr;
-					if (iss >> limitStr) {
-						std::istringstream lss(limitStr);
+					if (nextArg < cmd.paramCount()) {
+						StringView limitArg = cmd.param(nextArg++);
 						int limit = 0;
-						if (!(lss >> limit) || limit < 0) {
-							std::string err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " MODE :Not enough parameters\r\n";
-							send(_fd, err.c_str(), err.size(), 0);
-							return;
+						if (!parseLimit(limitArg, limit)) {
+							err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " MODE :Not enough parameters\r\n";
+						} else {
+							ch->setUserLimit(limit);
+							applied.add(true, 'l', limitArg.str());
 						}
-						ch->setUserLimit(limit);
-						std::string modeMsg = ":localhost MODE " + ch->getName() + " +l " + limitStr + "\r\n";
-						ch->broadcast(modeMsg, client_manager, -1);
 					} else {
-						std::string err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " MODE :Not enough parameters\r\n";
-						send(_fd, err.c_str(), err.size(), 0);
-						return;
+						err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " MODE :Not enough parameters\r\n";
 					}
 				} else {
 					// removing limit
 					ch->setUserLimit(0);
-					std::string modeMsg = ":localhost MODE " + ch->getName() + " -l\r\n";
-					ch->broadcast(modeMsg, client_manager, -1);
+					applied.add(false, 'l');
 				}
 			} else {
-				std::string err = ":localhost 472 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + modeChar + " :is unknown mode character to me\r\n";
-				send(_fd, err.c_str(), err.size(), 0);
-				return;
+				err = ":localhost 472 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + modeChar + " :is unknown mode character to me\r\n";
 			}
 		}
+		applied.flush(ch, client_manager);
+		if (!err.empty())
+			queueSend(err);
 	}
 	else {
 		std::string currentModes = ch->getModeString();
 		std::string modeMsg = ":localhost 324 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + ch->getName() + " " + currentModes + "\r\n";
-		send(_fd, modeMsg.c_str(), modeMsg.size(), 0);
+		queueSend(modeMsg);
 	}
 }
 
-void Client::handleQuit(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager) {
-	// Parse optional quit message
-	std::string reason;
-	if (!params.empty()) {
-		std::istringstream iss(params);
-		std::string token;
-		if (iss >> token) {
-			if (!token.empty() && token[0] == ':') {
-				reason = token.substr(1);
-				std::string rest;
-				std::getline(iss, rest);
-				if (!rest.empty()) {
-					if (rest[0] == ' ') rest.erase(0, 1);
-					reason += rest;
-				}
-			} else {
-				reason = token;
-				std::string rest;
-				std::getline(iss, rest);
-				if (!rest.empty()) {
-					if (rest[0] == ' ') rest.erase(0, 1);
-					reason += rest;
-				}
-			}
-		}
-	}
+void Client::handleQuit(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager) {
+	// Optional quit message
+	std::string reason = freeText(cmd, 0);
 
-	std::string quitMsg = ":" + (_nickname.empty() ? std::string("*") : _nickname) + "!" + _username + "@" + _hostname + " QUIT";
-	if (!reason.empty()) quitMsg += " :" + reason;
-	quitMsg += "\r\n";
+	MessageBuilder quitLine(getPrefix());
+	quitLine.word("QUIT");
+	if (!reason.empty()) quitLine.trailing(reason);
+	MessageRef quitMsg = quitLine.build();
 
 	// Notify all channels where this client is a member
 	if (channel_manager && client_manager) {
-		std::map<std::string, Channel*>& all = channel_manager->getAllChannels();
-		for (std::map<std::string, Channel*>::iterator it = all.begin(); it != all.end(); ++it) {
-			Channel* ch = it->second;
-			if (!ch) continue;
-			if (!ch->isMember(_fd)) continue;
-			std::map<int,bool> membersCopy = ch->getMembers();
-			for (std::map<int,bool>::const_iterator mit = membersCopy.begin(); mit != membersCopy.end(); ++mit) {
-				int memberFd = mit->first;
-				Client* target = client_manager->getClientByFd(memberFd);
-				if (!target) continue;
-				send(target->getFd(), quitMsg.c_str(), quitMsg.size(), 0);
-			}
-			ch->removeMember(_fd, client_manager, true);
-		}
+		if (!_channels.empty())
+			sendToCommonPeers(quitMsg, true);
+		// Walk a copy: removeMember updates _channels
+		std::vector<Channel*> joined(_channels);
+		for (size_t i = 0; i < joined.size(); ++i)
+			joined[i]->removeMember(_fd, client_manager, true);
 		// Mark client for removal by server loop; server will call ClientManager::removeClient
 		markForQuit();
 		return;
@@ -996,37 +981,159 @@ void Client::handleQuit(const std::string &params, ChannelManager *channel_manag
 	disconnect();
 }
 
+// PING <token>: answered with PONG. Any line, PONG included, counts as a
+// sign of life for the keepalive timer, so handlePong has nothing to do.
+void Client::handlePing(const ParsedCommand &cmd, ChannelManager *, ClientManager *) {
+	if (cmd.paramCount() == 0 || cmd.param(0).empty()) {
+		queueSend(":localhost 409 " + (_nickname.empty() ? std::string("*") : _nickname) + " :No origin specified\r\n");
+		return;
+	}
+	queueSend(MessageBuilder(":localhost").word("PONG").word("localhost").trailing(cmd.param(0)).build());
+}
+
+void Client::handlePong(const ParsedCommand &, ChannelManager *, ClientManager *) {
+}
+
+// STATS <query>: m = command counts (212), p = handler latency, t = traffic
+// and event loop, u = uptime (242). Every reply ends with 219.
+void Client::handleStats(const ParsedCommand &cmd, ChannelManager *, ClientManager *client_manager) {
+	const ServerStats& stats = serverStats();
+	char query = cmd.paramCount() && !cmd.param(0).empty() ? cmd.param(0)[0] : '*';
+	std::string head = ":localhost ";
+	std::string debug = head + "249 " + _nickname + " :";
+
+	if (query == 'm' || query == 'M') {
+		for (size_t i = 0; i < commandCount(); ++i) {
+			std::ostringstream line;
+			line << head << "212 " << _nickname << " " << commandAt(i).name << " "
+				<< stats.commandNs[i].count() << " 0 0\r\n";
+			queueSend(line.str());
+		}
+	} else if (query == 'p' || query == 'P') {
+		for (size_t i = 0; i < commandCount(); ++i) {
+			const Histogram& h = stats.commandNs[i];
+			if (h.count() == 0)
+				continue;
+			std::ostringstream line;
+			line << debug << commandAt(i).name << " calls " << h.count()
+				<< " p50 " << h.percentile(0.5) / 1000 << "us p99 " << h.percentile(0.99) / 1000
+				<< "us max " << h.max() / 1000 << "us\r\n";
+			queueSend(line.str());
+		}
+	} else if (query == 't' || query == 'T') {
+		QueueGauges q;
+		if (client_manager)
+			q = measureQueues(*client_manager);
+		std::ostringstream line;
+		line << debug << "in " << stats.messagesIn << " lines " << stats.bytesIn << " bytes, out "
+			<< stats.messagesOut << " lines " << stats.bytesOut << " bytes in " << stats.writeCalls << " writev, "
+			<< stats.floodThrottled << " flood holds\r\n";
+		line << debug << "loop " << stats.readyFds.count() << " wakeups, ready fds p50 "
+			<< stats.readyFds.percentile(0.5) << " max " << stats.readyFds.max() << ", busy p99 "
+			<< stats.loopBusyNs.percentile(0.99) / 1000 << "us\r\n";
+		line << debug << "accept " << stats.acceptsTotal << " in " << stats.acceptWakeups << " wakeups, "
+			<< q.clients << " clients, sendq " << q.queuedBytes << " bytes (max " << q.maxQueued << ")\r\n";
+		queueSend(line.str());
+	} else if (query == 'u' || query == 'U') {
+		long up = static_cast<long>(time(NULL) - stats.startedAt);
+		char text[64];
+		snprintf(text, sizeof(text), "Server Up %ld days %ld:%02ld:%02ld",
+			up / 86400, (up / 3600) % 24, (up / 60) % 60, up % 60);
+		queueSend(head + "242 " + _nickname + " :" + text + "\r\n");
+	}
+	queueSend(head + "219 " + _nickname + " " + query + " :End of STATS report\r\n");
+}
 
-void Client::handleClientMessage(const std::string &msg, ChannelManager *channel_manager, ClientManager *client_manager) {
+// Resolves the command through the command table and enforces the shared
+// preconditions (password, registration, parameter count) before calling
+// the handler.
+void Client::handleClientMessage(const StringView &msg, ChannelManager *channel_manager, ClientManager *client_manager) {
 	ParsedCommand parsed(msg);
-	std::string command = parsed.getCommand();
-	std::string params = parsed.getParams();
-
-	if (command == "PASS") {
-		handlePassword(params, client_manager);
-	} else if (command == "NICK") {
-		handleNick(params, channel_manager, client_manager);
-	} else if (command == "USER") {
-		handleUser(params, client_manager);
-	} else if (command == "JOIN") {
-		handleJoin(params, channel_manager, client_manager);
-	} else if (command == "PART") {
-		handlePart(params, channel_manager, client_manager);
-	} else if (command == "PRIVMSG") {
-		handlePrivateMessage(params, channel_manager, client_manager);
-	} else if (command == "KICK") {
-		handleKick(params, channel_manager, client_manager);
-	} else if (command == "INVITE") {
-		handleInvite(params, channel_manager, client_manager);
-	} else if (command == "TOPIC") {
-		handleTopic(params, channel_manager, client_manager);
-	} else if( command == "MODE") {
-		handleMode(params, channel_manager, client_manager);
-	} else if (command == "QUIT") {
-		handleQuit(params, channel_manager, client_manager);
-	} else {
-		sendUnknownCommand(command);
+	dispatch(parsed, findCommand(parsed.getCommand()), channel_manager, client_manager);
+}
+
+// Each line is parsed once: the command table supplies both its flood cost
+// and its handler. Unknown commands cost one token like the cheapest ones,
+// so junk cannot be sent faster than real traffic.
+Client::InputResult Client::takeInput(unsigned &budget, std::vector<InputLine> &batch) {
+	unsigned long long now = monotonicNanos();
+	while (_recvBuffer.hasLine()) {
+		if (budget == 0)
+			return INPUT_BUDGET;
+		InputLine line;
+		line.parsed.parse(_recvBuffer.peekLine());
+		line.spec = findCommand(line.parsed.getCommand());
+		unsigned cost = line.spec ? line.spec->floodCost : (line.parsed.getCommand().empty() ? 0 : 1);
+		if (!_flood.take(cost, now)) {
+			if (_heldCost == 0)
+				++_floodHolds;
+			_heldCost = cost;
+			return INPUT_THROTTLED;
+		}
+		_heldCost = 0;
+		_lastActivity = now;
+		_recvBuffer.popLine();	// the views in parsed stay valid until the next read
+		--budget;
+		batch.push_back(line);
+	}
+	return INPUT_DRAINED;
+}
+
+// Replies and counters are shared state, so overlong lines and flood holds
+// seen by takeInput() are reported here.
+void Client::runInput(const std::vector<InputLine> &batch, ChannelManager *channel_manager, ClientManager *client_manager) {
+	for (unsigned n = _recvBuffer.takeOverflows(); n > 0; --n) {
+		std::string err = ":localhost 417 " + (_nickname.empty() ? std::string("*") : _nickname) + " :Input line was too long\r\n";
+		queueSend(err);
+	}
+	serverStats().floodThrottled += _floodHolds;
+	_floodHolds = 0;
+	for (size_t i = 0; i < batch.size() && !_shouldQuit; ++i)
+		dispatch(batch[i].parsed, batch[i].spec, channel_manager, client_manager);
+}
+
+unsigned long long Client::inputReadyAt() const {
+	return _flood.readyAt(_heldCost, monotonicNanos());
+}
+
+void Client::setFloodLimits(unsigned rate, unsigned burst) {
+	_flood.configure(rate, burst);
+}
+
+Timer& Client::livenessTimer() { return _livenessTimer; }
+Timer& Client::floodTimer() { return _floodTimer; }
+unsigned long long Client::lastActivity() const { return _lastActivity; }
+
+void Client::dispatch(const ParsedCommand &parsed, const CommandSpec *spec, ChannelManager *channel_manager, ClientManager *client_manager) {
+	StringView command = parsed.getCommand();
+	if (command.empty())
+		return; // empty line
+	ServerStats& stats = serverStats();
+	++stats.messagesIn;
+
+	if (!spec) {
+		++stats.unknownCommands;
+		sendUnknownCommand(command.str());
+		return;
 	}
+	if (spec->needsPass && !_hasPass) {
+		std::string msg = ":localhost NOTICE * :You must set password first\r\n";
+		queueSend(msg);
+		return;
+	}
+	if (spec->needsRegistration && !_registered) {
+		std::string msg = ":localhost NOTICE * :You must be registered to use " + std::string(spec->name) + "\r\n";
+		queueSend(msg);
+		return;
+	}
+	if (parsed.paramCount() < spec->minParams) {
+		std::string err = ":localhost 461 " + (_nickname.empty() ? std::string("*") : _nickname) + " " + spec->name + " :Not enough parameters\r\n";
+		queueSend(err);
+		return;
+	}
+	unsigned long long started = monotonicNanos();
+	(this->*(spec->handler))(parsed, channel_manager, client_manager);
+	stats.commandNs[commandIndex(spec)].record(monotonicNanos() - started);
 }
 
 void Client::disconnect() {
@@ -1034,11 +1141,66 @@ void Client::disconnect() {
 	_fd = -1;
 }
 
+void Client::joinedChannel(Channel* channel) {
+	_channels.push_back(channel);
+}
+
+void Client::leftChannel(Channel* channel) {
+	for (size_t i = 0; i < _channels.size(); ++i) {
+		if (_channels[i] == channel) {
+			_channels[i] = _channels.back();
+			_channels.pop_back();
+			return;
+		}
+	}
+}
+
+// Each fan-out draws a fresh stamp from the manager; a peer is queued the
+// first time the walk reaches it and skipped on every later channel.
+void Client::sendToCommonPeers(const MessageRef& msg, bool includeSelf) {
+	if (!_manager)
+		return;
+	unsigned long stamp = _manager->nextFanoutStamp();
+	stampFanout(stamp);
+	if (includeSelf)
+		queueSend(msg);
+	for (size_t i = 0; i < _channels.size(); ++i) {
+		const MemberTable& members = _channels[i]->getMembers();
+		for (size_t m = 0; m < members.size(); ++m) {
+			Client* peer = members.valueAt(m).client;
+			if (peer->stampFanout(stamp))
+				peer->queueSend(msg);
+		}
+	}
+}
+
+// Returns true if this is the first time the client sees the stamp.
+bool Client::stampFanout(unsigned long stamp) {
+	if (_fanoutStamp == stamp)
+		return false;
+	_fanoutStamp = stamp;
+	return true;
+}
+
 void Client::markForQuit() {
+	if (_shouldQuit)
+		return;
 	_shouldQuit = true;
+	if (_manager)
+		_manager->scheduleRemoval(_fd);
+}
+
+void Client::markForQuit(const std::string& reason) {
+	if (!_shouldQuit)
+		_quitReason = reason;
+	markForQuit();
 }
 
 bool Client::shouldQuit() const {
 	return _shouldQuit;
 }
 
+const std::string& Client::getQuitReason() const {
+	return _quitReason;
+}
+
@@ -9,10 +9,19 @@
 #include <map>
 #include <sstream>
 #include <cctype>
+#include <deque>
+#include "Message.hpp"
+#include "RecvBuffer.hpp"
+#include "TokenBucket.hpp"
+#include "TimerWheel.hpp"
+#include "StringView.hpp"
+#include "ParsedCommand.hpp"
 
+class Channel;
 class ChannelManager;
 class ClientManager;
-class ParsedCommand;
+struct PoolStats;
+struct CommandSpec;
 
 class Client {
 private:
@@ -20,44 +29,108 @@ private:
     bool        _registered;
     bool        _hasPass;
     bool        _shouldQuit;
+    bool        _flushScheduled;
+    bool        _writeArmed;
+    bool        _readPaused;    // read interest dropped while input is held
+    bool        _sendQExceeded;
+    ClientManager* _manager;
+    int            _owner;          // worker thread serving this socket
+    unsigned long  _fanoutStamp;    // last fan-out that reached this client
 
     std::string _nickname;
     std::string _username;
     std::string _realname;
     std::string _hostname;
+    std::string _quitReason;
+    mutable std::string _prefix;        // ":nick!user@host", rebuilt on demand
+    mutable bool        _prefixValid;
 
-    std::string _recvBuffer;
-    std::string _sendBuffer;
+    RecvBuffer  _recvBuffer;
+    TokenBucket _flood;         // charged CommandSpec::floodCost per line
+    unsigned    _heldCost;      // cost of the line waiting for tokens
+    unsigned    _floodHolds;    // holds not yet counted in serverStats()
+    unsigned long long _lastActivity;   // monotonic ns of the last line run
+    Timer       _livenessTimer; // registration deadline, then keepalive
+    Timer       _floodTimer;    // resumes input held by the bucket
+    std::vector<Channel*> _channels;   // channels joined (kept by Channel)
+
+    // Output is queued by any worker under the state lock, then taken by
+    // the owning worker and written with the lock released. The write
+    // cursor and counters below belong to the owner alone; written
+    // messages are released in settleOutput(), under the lock again,
+    // since their reference counts are shared.
+    std::deque<MessageRef> _sendQueue;  // queued, not yet taken
+    std::deque<MessageRef> _writeQueue; // taken by the owner for writing
+    size_t      _sendQueued;    // unwritten bytes across both queues
+    size_t      _writeHead;     // write queue entries written since the last settle
+    size_t      _writeOffset;   // bytes of entry _writeHead already written
+    size_t      _written;       // bytes written since the last settle
+    unsigned long _writeCalls;  // writev() calls since the last settle
+
+    Client(const Client&);
+    Client& operator=(const Client&);
 
 public:
+    static const size_t MAX_LINE = 512;             // RFC 1459, CRLF included
+    static const size_t RECV_BUFFER_SIZE = 2048;    // one line plus a burst
+
+    enum InputResult {
+        INPUT_DRAINED,      // no complete line left
+        INPUT_BUDGET,       // line budget used up, more lines buffered
+        INPUT_THROTTLED     // next line waits for flood tokens
+    };
+
+    // A line taken from the receive buffer and paid for, waiting to run.
+    struct InputLine {
+        ParsedCommand       parsed;
+        const CommandSpec*  spec;
+    };
+
+    enum FlushResult {
+        FLUSH_DONE,     // queue fully written
+        FLUSH_PENDING,  // socket full, wait for writability
+        FLUSH_ERROR     // connection is broken
+    };
+
     // Constructors / Destructor
     Client();
-    Client(int fd);
+    Client(int fd, size_t recvQ = RECV_BUFFER_SIZE, size_t lineMax = MAX_LINE);
     ~Client();
 
+    // Storage comes from a slab pool (ObjectPool.hpp)
+    static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
+    static const PoolStats& poolStats();
+
     // --- Getters
     int                 getFd() const;
     const std::string&  getNick() const;
     const std::string&  getUser() const;
     const std::string&  getRealName() const;
     const std::string&  getHost() const;
-    const std::string&  getRecvBuffer() const;
+    const std::string&  getPrefix() const;  // ":nick!user@host" ("*" before NICK)
+    RecvBuffer&         getRecvBuffer();
+
+    const std::vector<Channel*>& getChannels() const;
 
     bool isRegistered() const;
     bool hasPass() const;
 
-    // --- Message handling
-    void handlePassword(const std::string &pass, ClientManager *client_manager);
-    void handleNick(const std::string &nick, ChannelManager *channel_manager, ClientManager *client_manager);
-    void handleUser(const std::string &user, ClientManager *client_manager);
-    void handleJoin(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager);
-    void handlePart(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager);
-    void handlePrivateMessage(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager);
-    void handleKick(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager);
-    void handleInvite(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager);
-    void handleQuit(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager);
-    void handleTopic(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager);
-    void handleMode(const std::string &params, ChannelManager *channel_manager, ClientManager *client_manager);
+    // --- Message handling (dispatched through CommandTable)
+    void handlePassword(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
+    void handleNick(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
+    void handleUser(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
+    void handleJoin(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
+    void handlePart(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
+    void handlePrivateMessage(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
+    void handleKick(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
+    void handleInvite(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
+    void handleQuit(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
+    void handleTopic(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
+    void handleMode(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
+    void handleStats(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
+    void handlePing(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
+    void handlePong(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
     void sendUnknownCommand(const std::string &Command);
 
     // --- Setters
@@ -69,19 +142,68 @@ public:
     void setRegistered(bool status);
 
     // --- Message buffers
-    void appendToRecv(const std::string& data);
-    bool hasCompleteMessage() const;
-    std::string popMessage();
-    void handleClientMessage(const std::string &msg, ChannelManager *channel_manager, ClientManager *client_manager);
+    // popMessage() returns a view into the receive buffer, valid until the
+    // next read from the socket.
+    size_t appendToRecv(const char* data, size_t len);  // bytes taken
+    bool hasCompleteMessage();
+    StringView popMessage();
+    void handleClientMessage(const StringView &msg, ChannelManager *channel_manager, ClientManager *client_manager);
+
+    // Input runs in two steps. takeInput() parses buffered lines into
+    // `batch` until none is complete, `budget` (decremented per line)
+    // reaches 0, or the flood bucket cannot pay for the next command; lines
+    // that are not taken stay buffered for a later call. It only touches the
+    // receive buffer and the bucket, which belong to the owning worker, so
+    // it runs without the state lock. runInput() then executes the batch
+    // with the lock held, stopping at QUIT. The views in `batch` are valid
+    // until the next read from the socket.
+    InputResult takeInput(unsigned &budget, std::vector<InputLine> &batch);
+    void runInput(const std::vector<InputLine> &batch, ChannelManager *channel_manager, ClientManager *client_manager);
+    unsigned long long inputReadyAt() const;    // when INPUT_THROTTLED ends
+    void setFloodLimits(unsigned rate, unsigned burst);
+
+    // --- Timers: armed and fired by the serving worker's TimerWheel
+    Timer& livenessTimer();
+    Timer& floodTimer();
+    unsigned long long lastActivity() const;
+
+    // --- Channel membership index, maintained by Channel::addMember/removeMember
+    void joinedChannel(Channel* channel);
+    void leftChannel(Channel* channel);
+
+    // Queues msg once for every client sharing at least one channel with
+    // this one, no matter how many channels they share.
+    void sendToCommonPeers(const MessageRef& msg, bool includeSelf);
+    bool stampFanout(unsigned long stamp);
 
     void markForQuit();
+    void markForQuit(const std::string& reason);
     bool shouldQuit() const;
+    const std::string& getQuitReason() const;
 
+    // --- Output queue: replies are queued and written by the server loop
+    void setManager(ClientManager* manager);
     void queueSend(const std::string& msg);
-    std::string flushSend();
+    void queueSend(const MessageRef& msg);
+    FlushResult flushSend();
+    bool takeOutput();
+    FlushResult writeOutput();
+    void settleOutput();
+    bool hasPendingOutput() const;
+    size_t pendingOutputSize() const;
+    void clearFlushScheduled();
+    bool isWriteArmed() const;
+    int getOwner() const;
+    void setOwner(int worker);
+    void setWriteArmed(bool armed);
+    bool isReadPaused() const;
+    void setReadPaused(bool paused);
 
     // --- Connection control
     void disconnect();
+
+private:
+    void dispatch(const ParsedCommand &parsed, const CommandSpec *spec, ChannelManager *channel_manager, ClientManager *client_manager);
 };
 
 #endif
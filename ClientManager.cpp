@@ -1,73 +1,126 @@
 #include "ClientManager.hpp"
 #include "Client.hpp"
+#include "Mailbox.hpp"
 
-ClientManager::ClientManager(std::string &serverPassword) : _serverPassword(serverPassword){}
+ClientManager::ClientManager(std::string &serverPassword)
+    : _serverPassword(serverPassword), _sendQLimit(DEFAULT_SENDQ),
+      _floodRate(0), _floodBurst(0), _currentWorker(0), _fanoutGeneration(0) {}
 
 ClientManager::~ClientManager() {
     // Clean up all client objects
-    std::map<int, Client*>::iterator it = _clients.begin();
-    for (it = _clients.begin(); it != _clients.end(); ++it) {
-        delete it->second;
+    for (size_t i = 0; i < _clients.size(); ++i) {
+        delete _clients.valueAt(i);
     }
     _clients.clear();
+    _nicks.clear();
 }
 
 // --- Add / remove client
 
 void ClientManager::addClient(Client* client) {
-    if (client)
-        _clients[client->getFd()] = client;
+    if (client) {
+        _clients.insert(client->getFd(), client);
+        client->setManager(this);
+        client->setFloodLimits(_floodRate, _floodBurst);
+    }
 }
 
 void ClientManager::removeClient(int fd) {
-    std::map<int, Client*>::iterator it = _clients.find(fd);
-    if (it != _clients.end()) {
-        it->second->disconnect();
-        delete it->second;
-        _clients.erase(it);
+    Client** slot = _clients.find(fd);
+    if (slot) {
+        Client* client = *slot;
+        _clients.erase(fd);
+        Client** indexed = _nicks.find(client->getNick());
+        if (indexed && *indexed == client)
+            _nicks.erase(client->getNick());
+        client->disconnect();
+        delete client;
     }
 }
 
 // --- Search
 
 Client* ClientManager::getClientByFd(int fd) {
-    std::map<int, Client*>::iterator it = _clients.find(fd);
-    if (it != _clients.end())
-        return it->second;
-    return NULL;
+    Client** slot = _clients.find(fd);
+    return slot ? *slot : NULL;
 }
 
-Client* ClientManager::getClientByNick(const std::string& nick) {
-    std::map<int, Client*>::iterator it;
-    for (it = _clients.begin(); it != _clients.end(); ++it) {
-        if (it->second->getNick() == nick)
-            return it->second;
-    }
-    return NULL;
+Client* ClientManager::getClientByNick(const StringView& nick) {
+    Client** slot = _nicks.find(nick);
+    return slot ? *slot : NULL;
 }
 
 Client* ClientManager::getClientByUser(const std::string& user) {
-    std::map<int, Client*>::iterator it;
-    for (it = _clients.begin(); it != _clients.end(); ++it) {
-        if (it->second->getUser() == user)
-            return it->second;
+    for (size_t i = 0; i < _clients.size(); ++i) {
+        if (_clients.valueAt(i)->getUser() == user)
+            return _clients.valueAt(i);
     }
     return NULL;
 }
 
 // --- Utilities
 
-std::map<int, Client*>& ClientManager::getAllClients() {
+FdTable<Client*>& ClientManager::getAllClients() {
     return _clients;
 }
 
-bool ClientManager::nicknameExists(const std::string& nick) const {
-    std::map<int, Client*>::const_iterator it;
-    for (it = _clients.begin(); it != _clients.end(); ++it) {
-        if (it->second->getNick() == nick)
-            return true;
+bool ClientManager::nicknameExists(const StringView& nick) const {
+    return _nicks.find(nick) != NULL;
+}
+
+void ClientManager::renameClient(Client* client, const std::string& oldNick) {
+    if (!oldNick.empty()) {
+        Client** indexed = _nicks.find(oldNick);
+        if (indexed && *indexed == client)
+            _nicks.erase(oldNick);
     }
-    return false;
+    if (!client->getNick().empty())
+        _nicks.insert(client->getNick(), client);
+}
+
+// --- Deferred work
+
+void ClientManager::setMailboxes(const std::vector<Mailbox*>& mailboxes) {
+    _mailboxes = mailboxes;
+}
+
+void ClientManager::setCurrentWorker(int worker) {
+    _currentWorker = worker;
+}
+
+void ClientManager::scheduleFlush(int fd) {
+    Client** slot = _clients.find(fd);
+    if (!slot || _mailboxes.empty())
+        return;
+    int owner = (*slot)->getOwner();
+    _mailboxes[owner]->postFlush(fd, owner != _currentWorker);
+}
+
+void ClientManager::scheduleRemoval(int fd) {
+    Client** slot = _clients.find(fd);
+    if (!slot || _mailboxes.empty())
+        return;
+    int owner = (*slot)->getOwner();
+    _mailboxes[owner]->postRemoval(fd, owner != _currentWorker);
+}
+
+unsigned long ClientManager::nextFanoutStamp() {
+    if (++_fanoutGeneration == 0)
+        ++_fanoutGeneration;
+    return _fanoutGeneration;
+}
+
+void ClientManager::setSendQLimit(size_t limit) {
+    _sendQLimit = limit;
+}
+
+size_t ClientManager::getSendQLimit() const {
+    return _sendQLimit;
+}
+
+void ClientManager::setFloodLimits(unsigned rate, unsigned burst) {
+    _floodRate = rate;
+    _floodBurst = burst;
 }
 
 bool ClientManager::checkPassword(const std::string& pass) const {
@@ -1,17 +1,30 @@
 #ifndef CLIENT_MANAGER_HPP
 #define CLIENT_MANAGER_HPP
 
-#include <map>
 #include <string>
+#include <vector>
+#include "FdTable.hpp"
+#include "FlatHashMap.hpp"
+#include "CaseMap.hpp"
 
 class Client; // forward declaration to avoid circular include
+class Mailbox;
 
 class ClientManager {
 private:
-    std::map<int, Client*> _clients;  // fd -> Client*
+    FdTable<Client*> _clients;  // fd -> Client*
+    FlatHashMap<std::string, Client*, IrcNameTraits> _nicks;  // casemapped nick -> Client*
     std::string _serverPassword;
+    size_t _sendQLimit;                 // max queued output bytes per client
+    unsigned _floodRate;                // tokens per second, 0 = unlimited
+    unsigned _floodBurst;
+    std::vector<Mailbox*> _mailboxes;   // deferred work, one per worker
+    int _currentWorker;                 // worker holding the state lock
+    unsigned long _fanoutGeneration;    // see Client::sendToCommonPeers
 
 public:
+    static const size_t DEFAULT_SENDQ = 512 * 1024;
+
     ClientManager(std::string &serverPassword);
     ~ClientManager();
 
@@ -21,16 +34,36 @@ public:
 
     // Search
     Client* getClientByFd(int fd);
-    Client* getClientByNick(const std::string& nick);
+    Client* getClientByNick(const StringView& nick);
     Client* getClientByUser(const std::string& user);
 
     // Iterate / utility
-    std::map<int, Client*>& getAllClients();
-    bool nicknameExists(const std::string& nick) const;
+    FdTable<Client*>& getAllClients();
+    bool nicknameExists(const StringView& nick) const;
+
+    // Keeps the nick index in sync; call after the client's nick changed.
+    void renameClient(Client* client, const std::string& oldNick);
+
+    // Deferred work is posted to the mailbox of the worker owning the
+    // client and drained by that worker after its batch of events. Posts
+    // for another worker wake its event loop.
+    void setMailboxes(const std::vector<Mailbox*>& mailboxes);
+    void setCurrentWorker(int worker);
+    void scheduleFlush(int fd);
+    void scheduleRemoval(int fd);
+
+    // Stamp for one deduplicated fan-out; never returns 0, the value
+    // fresh clients start with.
+    unsigned long nextFanoutStamp();
+
+    void setSendQLimit(size_t limit);
+    size_t getSendQLimit() const;
+
+    // Flood bucket given to clients as they are added.
+    void setFloodLimits(unsigned rate, unsigned burst);
 
     // Password management
     bool checkPassword(const std::string& pass) const;
 };
 
 #endif
-
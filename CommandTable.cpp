@@ -0,0 +1,91 @@
+#include "CommandTable.hpp"
+#include "Client.hpp"
+#include "Stats.hpp"
+
+enum {
+    CMD_PASS, CMD_NICK, CMD_USER, CMD_JOIN, CMD_PART, CMD_PRIVMSG,
+    CMD_KICK, CMD_INVITE, CMD_TOPIC, CMD_MODE, CMD_QUIT, CMD_STATS,
+    CMD_PING, CMD_PONG, CMD_COUNT
+};
+
+// Compile-time check: every command gets a latency histogram
+typedef char command_stats_fit[CMD_COUNT <= ServerStats::MAX_COMMANDS ? 1 : -1];
+
+static const CommandSpec g_commands[CMD_COUNT] = {
+    // name       handler                         min  pass   reg    cost
+    { "PASS",    &Client::handlePassword,         1,  false, false, 1 },
+    { "NICK",    &Client::handleNick,             0,  true,  false, 2 },
+    { "USER",    &Client::handleUser,             0,  true,  false, 1 },
+    { "JOIN",    &Client::handleJoin,             1,  true,  true,  2 },
+    { "PART",    &Client::handlePart,             1,  true,  true,  1 },
+    { "PRIVMSG", &Client::handlePrivateMessage,   1,  true,  true,  1 },
+    { "KICK",    &Client::handleKick,             2,  true,  true,  2 },
+    { "INVITE",  &Client::handleInvite,           2,  true,  true,  2 },
+    { "TOPIC",   &Client::handleTopic,            1,  true,  true,  1 },
+    { "MODE",    &Client::handleMode,             1,  true,  true,  2 },
+    { "QUIT",    &Client::handleQuit,             0,  false, false, 0 },
+    { "STATS",   &Client::handleStats,            0,  true,  true,  2 },
+    { "PING",    &Client::handlePing,             0,  true,  true,  1 },
+    { "PONG",    &Client::handlePong,             0,  false, false, 0 }
+};
+
+static char upper(char c) {
+    return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+static const CommandSpec* confirm(int id, const StringView& name) {
+    const char* expected = g_commands[id].name;
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (upper(name[i]) != expected[i])
+            return NULL;
+    }
+    return expected[name.size()] == '\0' ? &g_commands[id] : NULL;
+}
+
+const CommandSpec* findCommand(const StringView& name) {
+    if (name.empty())
+        return NULL;
+    char c0 = upper(name[0]);
+    switch (name.size()) {
+    case 4:
+        switch (c0) {
+        case 'P':
+            switch (upper(name[1])) {
+            case 'A': return confirm(upper(name[2]) == 'S' ? CMD_PASS : CMD_PART, name);
+            case 'I': return confirm(CMD_PING, name);
+            case 'O': return confirm(CMD_PONG, name);
+            }
+            return NULL;
+        case 'N': return confirm(CMD_NICK, name);
+        case 'U': return confirm(CMD_USER, name);
+        case 'J': return confirm(CMD_JOIN, name);
+        case 'K': return confirm(CMD_KICK, name);
+        case 'M': return confirm(CMD_MODE, name);
+        case 'Q': return confirm(CMD_QUIT, name);
+        }
+        return NULL;
+    case 5:
+        switch (c0) {
+        case 'T': return confirm(CMD_TOPIC, name);
+        case 'S': return confirm(CMD_STATS, name);
+        }
+        return NULL;
+    case 6:
+        return c0 == 'I' ? confirm(CMD_INVITE, name) : NULL;
+    case 7:
+        return c0 == 'P' ? confirm(CMD_PRIVMSG, name) : NULL;
+    }
+    return NULL;
+}
+
+size_t commandCount() {
+    return CMD_COUNT;
+}
+
+const CommandSpec& commandAt(size_t index) {
+    return g_commands[index];
+}
+
+size_t commandIndex(const CommandSpec* spec) {
+    return static_cast<size_t>(spec - g_commands);
+}
@@ -0,0 +1,34 @@
+#ifndef COMMAND_TABLE_HPP
+#define COMMAND_TABLE_HPP
+
+#include <cstddef>
+#include "StringView.hpp"
+
+class Client;
+class ChannelManager;
+class ClientManager;
+class ParsedCommand;
+
+typedef void (Client::*CommandHandler)(const ParsedCommand &cmd, ChannelManager *channel_manager, ClientManager *client_manager);
+
+// Per-command metadata; the common preconditions are enforced by
+// Client::handleClientMessage before the handler runs.
+struct CommandSpec {
+    const char*     name;
+    CommandHandler  handler;
+    unsigned char   minParams;          // else 461 ERR_NEEDMOREPARAMS
+    bool            needsPass;          // PASS must have been accepted
+    bool            needsRegistration;  // NICK and USER must be done
+    unsigned char   floodCost;          // tokens charged per use
+};
+
+// O(1) lookup: switches on length and first letter, then confirms with a
+// single case-insensitive compare. Returns NULL for unknown commands.
+const CommandSpec* findCommand(const StringView& name);
+
+// Iteration over the table, e.g. for per-command statistics.
+size_t commandCount();
+const CommandSpec& commandAt(size_t index);
+size_t commandIndex(const CommandSpec* spec);
+
+#endif
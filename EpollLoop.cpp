@@ -0,0 +1,70 @@
+#include "EpollLoop.hpp"
+
+#ifdef __linux__
+
+#include <unistd.h>
+#include <cerrno>
+#include <stdexcept>
+
+EpollLoop::EpollLoop() : _epfd(-1), _events(256) {
+    _epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epfd < 0)
+        throw std::runtime_error("Failed to create epoll instance");
+}
+
+EpollLoop::~EpollLoop() {
+    if (_epfd != -1)
+        close(_epfd);
+}
+
+void EpollLoop::control(int op, int fd, unsigned events) {
+    struct epoll_event ev;
+    ev.events = EPOLLET | EPOLLRDHUP;
+    if (events & EV_READ)  ev.events |= EPOLLIN;
+    if (events & EV_WRITE) ev.events |= EPOLLOUT;
+    ev.data.u64 = 0;
+    ev.data.fd = fd;
+    if (epoll_ctl(_epfd, op, fd, &ev) < 0)
+        throw std::runtime_error("epoll_ctl() failed");
+}
+
+void EpollLoop::add(int fd, unsigned events) {
+    control(EPOLL_CTL_ADD, fd, events);
+}
+
+void EpollLoop::modify(int fd, unsigned events) {
+    control(EPOLL_CTL_MOD, fd, events);
+}
+
+void EpollLoop::remove(int fd) {
+    // A closed fd is dropped by the kernel automatically; ignore errors.
+    epoll_ctl(_epfd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+int EpollLoop::wait(std::vector<IoEvent>& out, int timeoutMs) {
+    out.clear();
+    int ready = epoll_wait(_epfd, &_events[0], static_cast<int>(_events.size()), timeoutMs);
+    if (ready <= 0)
+        return ready;
+    for (int i = 0; i < ready; ++i) {
+        unsigned re = _events[i].events;
+        IoEvent ev;
+        ev.fd = _events[i].data.fd;
+        ev.events = 0;
+        if (re & EPOLLIN)  ev.events |= EV_READ;
+        if (re & EPOLLOUT) ev.events |= EV_WRITE;
+        if (re & EPOLLERR) ev.events |= EV_ERROR;
+        if (re & (EPOLLHUP | EPOLLRDHUP)) ev.events |= EV_HANGUP;
+        out.push_back(ev);
+    }
+    // Grow the batch when the kernel filled it, so bursts drain in fewer calls.
+    if (ready == static_cast<int>(_events.size()))
+        _events.resize(_events.size() * 2);
+    return ready;
+}
+
+const char* EpollLoop::name() const {
+    return "epoll";
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef EPOLL_LOOP_HPP
+#define EPOLL_LOOP_HPP
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+#include <vector>
+#include "EventLoop.hpp"
+
+// Edge-triggered epoll backend (Linux only).
+class EpollLoop : public EventLoop {
+private:
+    int                         _epfd;
+    std::vector<epoll_event>    _events;
+
+    EpollLoop(const EpollLoop&);
+    EpollLoop& operator=(const EpollLoop&);
+
+    void control(int op, int fd, unsigned events);
+
+public:
+    EpollLoop();
+    virtual ~EpollLoop();
+
+    virtual void add(int fd, unsigned events);
+    virtual void modify(int fd, unsigned events);
+    virtual void remove(int fd);
+    virtual int  wait(std::vector<IoEvent>& out, int timeoutMs);
+    virtual const char* name() const;
+};
+
+#endif
+
+#endif
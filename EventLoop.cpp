@@ -0,0 +1,14 @@
+#include "EventLoop.hpp"
+#include "PollLoop.hpp"
+#include "EpollLoop.hpp"
+
+EventLoop::~EventLoop() {}
+
+EventLoop* EventLoop::create(const std::string& backend) {
+#ifdef __linux__
+    if (backend.empty() || backend == "epoll")
+        return new EpollLoop();
+#endif
+    (void)backend;
+    return new PollLoop();
+}
@@ -0,0 +1,46 @@
+#ifndef EVENT_LOOP_HPP
+#define EVENT_LOOP_HPP
+
+#include <string>
+#include <vector>
+
+// One readiness notification returned by EventLoop::wait().
+struct IoEvent {
+    int         fd;
+    unsigned    events;     // EventLoop::EV_* bits
+};
+
+// Small readiness-notification interface so the server does not depend on a
+// particular multiplexing syscall. Backends:
+//   - "epoll": edge-triggered epoll (Linux); per-wakeup cost scales with the
+//     number of ready descriptors.
+//   - "poll" : portable poll() fallback; scans every registered descriptor.
+// Since the epoll backend is edge-triggered, callers must always drain a
+// readable socket until EAGAIN.
+class EventLoop {
+public:
+    enum {
+        EV_READ   = 1 << 0,
+        EV_WRITE  = 1 << 1,
+        EV_ERROR  = 1 << 2,
+        EV_HANGUP = 1 << 3
+    };
+
+    virtual ~EventLoop();
+
+    virtual void add(int fd, unsigned events) = 0;
+    virtual void modify(int fd, unsigned events) = 0;
+    virtual void remove(int fd) = 0;
+
+    // Blocks up to timeoutMs (-1 = forever) and fills `out` with ready fds.
+    // Returns the number of events, or -1 with errno set (EINTR included).
+    virtual int wait(std::vector<IoEvent>& out, int timeoutMs) = 0;
+
+    virtual const char* name() const = 0;
+
+    // Builds the requested backend ("epoll" or "poll"). Falls back to poll
+    // when epoll is not available on this platform.
+    static EventLoop* create(const std::string& backend);
+};
+
+#endif
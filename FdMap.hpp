@@ -0,0 +1,141 @@
+#ifndef FD_MAP_HPP
+#define FD_MAP_HPP
+
+#include <vector>
+#include <cstddef>
+
+// Sparse counterpart of FdTable for small per-channel sets. Values stay
+// packed in a dense array (swap-remove on erase) for cache-friendly
+// iteration, but fds are located through a linear-probing index sized to
+// the entry count instead of a slot array sized to the highest fd, so a
+// channel with a few members on high fds stays small. The index shrinks
+// as entries leave.
+//
+// Same interface as FdTable: when removing while iterating, walk the
+// dense array from the back.
+template <typename T>
+class FdMap {
+private:
+    enum { MIN_CAPACITY = 8 };
+
+    std::vector<int>    _index;     // probe slot -> position in _values, -1 if empty
+    std::vector<int>    _fds;       // position -> fd
+    std::vector<T>      _values;    // position -> value
+
+    size_t home(int fd) const {
+        // Multiply and fold the high bits down, so strided fd runs spread
+        unsigned h = static_cast<unsigned>(fd) * 2654435769u;
+        return (h ^ (h >> 16)) & (_index.size() - 1);
+    }
+
+    // Probe slot holding fd, or the empty slot where it would go.
+    size_t probe(int fd) const {
+        size_t mask = _index.size() - 1;
+        size_t i = home(fd);
+        while (_index[i] >= 0 && _fds[_index[i]] != fd)
+            i = (i + 1) & mask;
+        return i;
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<int>(capacity, -1).swap(_index);
+        for (size_t pos = 0; pos < _fds.size(); ++pos)
+            _index[probe(_fds[pos])] = static_cast<int>(pos);
+    }
+
+    // Empties probe slot i, shifting later entries of the same cluster back
+    // so lookups never need tombstones.
+    void unlink(size_t i) {
+        size_t mask = _index.size() - 1;
+        size_t j = i;
+        while (true) {
+            j = (j + 1) & mask;
+            if (_index[j] < 0)
+                break;
+            size_t k = home(_fds[_index[j]]);
+            // Move j into the hole unless its home lies cyclically in (i, j]
+            bool stays = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+            if (!stays) {
+                _index[i] = _index[j];
+                i = j;
+            }
+        }
+        _index[i] = -1;
+    }
+
+public:
+    FdMap() {}
+
+    size_t size() const { return _values.size(); }
+    bool empty() const { return _values.empty(); }
+
+    bool contains(int fd) const {
+        return !_index.empty() && _index[probe(fd)] >= 0;
+    }
+
+    T* find(int fd) {
+        if (_index.empty()) return NULL;
+        int pos = _index[probe(fd)];
+        return pos < 0 ? NULL : &_values[pos];
+    }
+
+    const T* find(int fd) const {
+        if (_index.empty()) return NULL;
+        int pos = _index[probe(fd)];
+        return pos < 0 ? NULL : &_values[pos];
+    }
+
+    // Inserts or replaces the value stored for fd.
+    void insert(int fd, const T& value) {
+        if (fd < 0) return;
+        if (!_index.empty()) {
+            int pos = _index[probe(fd)];
+            if (pos >= 0) {
+                _values[pos] = value;
+                return;
+            }
+        }
+        // Keep the index at most half full
+        if ((_values.size() + 1) * 2 > _index.size())
+            rehash(_index.empty() ? static_cast<size_t>(MIN_CAPACITY) : _index.size() * 2);
+        _index[probe(fd)] = static_cast<int>(_values.size());
+        _fds.push_back(fd);
+        _values.push_back(value);
+    }
+
+    bool erase(int fd) {
+        if (_index.empty()) return false;
+        size_t i = probe(fd);
+        int pos = _index[i];
+        if (pos < 0) return false;
+        unlink(i);
+        int last = static_cast<int>(_values.size()) - 1;
+        if (pos != last) {
+            _values[pos] = _values[last];
+            _fds[pos] = _fds[last];
+            _index[probe(_fds[pos])] = pos;
+        }
+        _values.pop_back();
+        _fds.pop_back();
+        if (_values.empty())
+            clear();
+        else if (_index.size() > MIN_CAPACITY && _values.size() * 8 < _index.size())
+            rehash(_index.size() / 2);
+        return true;
+    }
+
+    // Releases the storage as well.
+    void clear() {
+        std::vector<int>().swap(_index);
+        std::vector<int>().swap(_fds);
+        std::vector<T>().swap(_values);
+    }
+
+    // Dense iteration
+    int fdAt(size_t i) const { return _fds[i]; }
+    T& valueAt(size_t i) { return _values[i]; }
+    const T& valueAt(size_t i) const { return _values[i]; }
+    T* data() { return _values.empty() ? NULL : &_values[0]; }
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef FD_TABLE_HPP
+#define FD_TABLE_HPP
+
+#include <vector>
+#include <cstddef>
+
+// Fd-indexed slot table. Descriptors are small dense integers, so a slot
+// array indexed by fd gives O(1) lookup, and values are kept packed in a
+// dense array (swap-remove on erase) for O(1) removal and cache-friendly
+// iteration. Used for the client table and the poll() descriptor set.
+//
+// Erasing moves the last entry into the freed position: when removing
+// while iterating, walk the dense array from the back.
+template <typename T>
+class FdTable {
+private:
+    std::vector<int>    _slotOf;    // fd -> position in _values, -1 if free
+    std::vector<int>    _fds;       // position -> fd
+    std::vector<T>      _values;    // position -> value
+
+public:
+    FdTable() {}
+
+    size_t size() const { return _values.size(); }
+    bool empty() const { return _values.empty(); }
+
+    bool contains(int fd) const {
+        return fd >= 0 && static_cast<size_t>(fd) < _slotOf.size() && _slotOf[fd] >= 0;
+    }
+
+    T* find(int fd) {
+        if (!contains(fd)) return NULL;
+        return &_values[_slotOf[fd]];
+    }
+
+    const T* find(int fd) const {
+        if (!contains(fd)) return NULL;
+        return &_values[_slotOf[fd]];
+    }
+
+    // Inserts or replaces the value stored for fd.
+    void insert(int fd, const T& value) {
+        if (fd < 0) return;
+        if (static_cast<size_t>(fd) >= _slotOf.size())
+            _slotOf.resize(fd + 1, -1);
+        if (_slotOf[fd] >= 0) {
+            _values[_slotOf[fd]] = value;
+            return;
+        }
+        _slotOf[fd] = static_cast<int>(_values.size());
+        _fds.push_back(fd);
+        _values.push_back(value);
+    }
+
+    bool erase(int fd) {
+        if (!contains(fd)) return false;
+        int pos = _slotOf[fd];
+        int last = static_cast<int>(_values.size()) - 1;
+        if (pos != last) {
+            _values[pos] = _values[last];
+            _fds[pos] = _fds[last];
+            _slotOf[_fds[pos]] = pos;
+        }
+        _values.pop_back();
+        _fds.pop_back();
+        _slotOf[fd] = -1;
+        return true;
+    }
+
+    void clear() {
+        _slotOf.clear();
+        _fds.clear();
+        _values.clear();
+    }
+
+    // Dense iteration
+    int fdAt(size_t i) const { return _fds[i]; }
+    T& valueAt(size_t i) { return _values[i]; }
+    const T& valueAt(size_t i) const { return _values[i]; }
+    T* data() { return _values.empty() ? NULL : &_values[0]; }
+};
+
+#endif
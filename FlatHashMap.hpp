@@ -0,0 +1,138 @@
+#ifndef FLAT_HASH_MAP_HPP
+#define FLAT_HASH_MAP_HPP
+
+#include <vector>
+#include <cstddef>
+
+// Open-addressing hash table with linear probing. Each slot keeps the full
+// hash so probes compare keys only on a hash match and growth never
+// rehashes keys. Traits supplies `static size_t hash(q)` and
+// `static bool equal(key, q)`; lookups are templated on the query type so
+// a StringView can look up std::string keys without allocating.
+//
+// Iterate with slotCount()/isFull(i)/keyAt(i)/valueAt(i). Erasing leaves a
+// tombstone, so erasing the current slot while iterating is safe.
+template <typename K, typename V, typename Traits>
+class FlatHashMap {
+private:
+    enum { EMPTY = 0, FULL = 1, DELETED = 2 };
+
+    struct Slot {
+        K               key;
+        V               value;
+        size_t          hash;
+        unsigned char   state;
+        Slot() : key(), value(), hash(0), state(EMPTY) {}
+    };
+
+    std::vector<Slot>   _slots;
+    size_t              _size;
+    size_t              _used;      // FULL + DELETED slots
+
+    template <typename Q>
+    long locate(const Q& q, size_t h) const {
+        if (_slots.empty())
+            return -1;
+        size_t mask = _slots.size() - 1;
+        for (size_t i = h & mask; ; i = (i + 1) & mask) {
+            const Slot& s = _slots[i];
+            if (s.state == EMPTY)
+                return -1;
+            if (s.state == FULL && s.hash == h && Traits::equal(s.key, q))
+                return static_cast<long>(i);
+        }
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<Slot> old;
+        old.swap(_slots);
+        _slots.resize(capacity);
+        _used = _size;
+        size_t mask = capacity - 1;
+        for (size_t j = 0; j < old.size(); ++j) {
+            if (old[j].state != FULL)
+                continue;
+            size_t i = old[j].hash & mask;
+            while (_slots[i].state != EMPTY)
+                i = (i + 1) & mask;
+            _slots[i] = old[j];
+        }
+    }
+
+public:
+    FlatHashMap() : _size(0), _used(0) {}
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    template <typename Q>
+    V* find(const Q& q) { return findHashed(q, Traits::hash(q)); }
+
+    template <typename Q>
+    const V* find(const Q& q) const {
+        long i = locate(q, Traits::hash(q));
+        return i < 0 ? NULL : &_slots[i].value;
+    }
+
+    // Lookup with a hash the caller already computed (e.g. cached).
+    template <typename Q>
+    V* findHashed(const Q& q, size_t h) {
+        long i = locate(q, h);
+        return i < 0 ? NULL : &_slots[i].value;
+    }
+
+    // Inserts or replaces.
+    void insert(const K& key, const V& value) { insertHashed(key, value, Traits::hash(key)); }
+
+    void insertHashed(const K& key, const V& value, size_t h) {
+        long found = locate(key, h);
+        if (found >= 0) {
+            _slots[found].value = value;
+            return;
+        }
+        // Keep FULL + DELETED at most half of the table
+        if ((_used + 1) * 2 > _slots.size())
+            rehash(_slots.empty() ? 16 : (_size + 1) * 4 > _slots.size() ? _slots.size() * 2 : _slots.size());
+        size_t mask = _slots.size() - 1;
+        size_t i = h & mask;
+        while (_slots[i].state == FULL)
+            i = (i + 1) & mask;
+        if (_slots[i].state == EMPTY)
+            ++_used;
+        _slots[i].key = key;
+        _slots[i].value = value;
+        _slots[i].hash = h;
+        _slots[i].state = FULL;
+        ++_size;
+    }
+
+    template <typename Q>
+    bool erase(const Q& q) { return eraseHashed(q, Traits::hash(q)); }
+
+    template <typename Q>
+    bool eraseHashed(const Q& q, size_t h) {
+        long i = locate(q, h);
+        if (i < 0)
+            return false;
+        _slots[i].key = K();
+        _slots[i].value = V();
+        _slots[i].state = DELETED;
+        --_size;
+        return true;
+    }
+
+    void clear() {
+        _slots.clear();
+        _size = 0;
+        _used = 0;
+    }
+
+    // Slot iteration
+    size_t slotCount() const { return _slots.size(); }
+    bool isFull(size_t i) const { return _slots[i].state == FULL; }
+    const K& keyAt(size_t i) const { return _slots[i].key; }
+    V& valueAt(size_t i) { return _slots[i].value; }
+    const V& valueAt(size_t i) const { return _slots[i].value; }
+};
+
+#endif
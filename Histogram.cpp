@@ -0,0 +1,78 @@
+#include "Histogram.hpp"
+#include <ctime>
+
+Histogram::Histogram() : _count(0), _sum(0), _max(0) {
+    for (int i = 0; i < BUCKETS; ++i)
+        _buckets[i] = 0;
+}
+
+// Values below SUB_COUNT get a bucket each; above that, the bucket is the
+// position of the highest set bit plus the next SUB_BITS bits.
+int Histogram::bucketOf(unsigned long long value) {
+    if (value < static_cast<unsigned long long>(SUB_COUNT))
+        return static_cast<int>(value);
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - SUB_BITS;
+    return (shift + 1) * SUB_COUNT + static_cast<int>((value >> shift) & (SUB_COUNT - 1));
+}
+
+unsigned long long Histogram::bucketUpper(int index) {
+    if (index < SUB_COUNT)
+        return static_cast<unsigned long long>(index);
+    int shift = index / SUB_COUNT - 1;
+    unsigned long long sub = static_cast<unsigned long long>(SUB_COUNT + index % SUB_COUNT);
+    return ((sub + 1) << shift) - 1;
+}
+
+void Histogram::record(unsigned long long value) {
+    __atomic_add_fetch(&_buckets[bucketOf(value)], 1ULL, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&_count, 1ULL, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&_sum, value, __ATOMIC_RELAXED);
+    unsigned long long seen = __atomic_load_n(&_max, __ATOMIC_RELAXED);
+    while (value > seen
+           && !__atomic_compare_exchange_n(&_max, &seen, value, true,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+unsigned long long Histogram::count() const {
+    return __atomic_load_n(&_count, __ATOMIC_RELAXED);
+}
+
+unsigned long long Histogram::sum() const {
+    return __atomic_load_n(&_sum, __ATOMIC_RELAXED);
+}
+
+unsigned long long Histogram::max() const {
+    return __atomic_load_n(&_max, __ATOMIC_RELAXED);
+}
+
+double Histogram::mean() const {
+    unsigned long long n = count();
+    return n ? static_cast<double>(sum()) / static_cast<double>(n) : 0.0;
+}
+
+unsigned long long Histogram::percentile(double q) const {
+    unsigned long long total = count();
+    if (total == 0)
+        return 0;
+    unsigned long long target = static_cast<unsigned long long>(q * static_cast<double>(total));
+    if (target < 1)
+        target = 1;
+    unsigned long long seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        seen += __atomic_load_n(&_buckets[i], __ATOMIC_RELAXED);
+        if (seen >= target) {
+            unsigned long long upper = bucketUpper(i);
+            unsigned long long top = max();
+            return upper < top ? upper : top;
+        }
+    }
+    return max();
+}
+
+unsigned long long monotonicNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL
+        + static_cast<unsigned long long>(ts.tv_nsec);
+}
@@ -0,0 +1,42 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <cstddef>
+
+// Log-linear histogram in the style of HdrHistogram: every power of two is
+// split into 8 sub-buckets, so any recorded value is known to within
+// 12.5% over the whole 64-bit range with a fixed 4 KB of counters.
+// record() uses relaxed atomic adds and may be called from any thread
+// without a lock; readers get a consistent-enough snapshot for reporting.
+class Histogram {
+public:
+    static const int SUB_BITS = 3;
+    static const int SUB_COUNT = 1 << SUB_BITS;
+    static const int BUCKETS = (64 - SUB_BITS + 1) * SUB_COUNT;
+
+    Histogram();
+
+    void record(unsigned long long value);
+
+    unsigned long long count() const;
+    unsigned long long sum() const;
+    unsigned long long max() const;
+    double mean() const;
+
+    // Smallest bucket upper bound covering fraction q (0..1) of the values.
+    unsigned long long percentile(double q) const;
+
+private:
+    unsigned long long  _buckets[BUCKETS];
+    unsigned long long  _count;
+    unsigned long long  _sum;
+    unsigned long long  _max;
+
+    static int bucketOf(unsigned long long value);
+    static unsigned long long bucketUpper(int index);
+};
+
+// Monotonic clock in nanoseconds, for latency measurements.
+unsigned long long monotonicNanos();
+
+#endif
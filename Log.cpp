@@ -0,0 +1,279 @@
+#include "Log.hpp"
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <pthread.h>
+
+// --- Ring buffer
+//
+// Bounded multi-producer queue (Vyukov): each slot carries a sequence
+// number telling producers and the consumer whose turn it is. A producer
+// claims a slot with one CAS on the head ticket; the flusher is the only
+// consumer.
+
+namespace {
+
+const size_t RING_SIZE = 4096;          // power of two
+const size_t SLOT_TEXT = 240;
+
+struct Slot {
+    size_t          seq;
+    unsigned char   level;
+    unsigned short  len;
+    char            text[SLOT_TEXT];
+};
+
+Slot            g_ring[RING_SIZE];
+size_t          g_head = 0;             // next ticket for producers
+size_t          g_tail = 0;             // next ticket for the flusher
+unsigned long   g_dropped = 0;
+int             g_running = 0;
+pthread_t       g_flusher;
+
+// The flusher sleeps on g_wake when it finds the ring empty, with
+// g_sleeping set; the first producer to push after that clears the flag
+// and signals, so an idle server has no periodic wakeups at all.
+pthread_mutex_t g_wakeLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t  g_wake = PTHREAD_COND_INITIALIZER;
+int             g_sleeping = 0;
+
+void writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return;     // nowhere left to report it
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+bool push(Log::Level level, const char* text, size_t len) {
+    size_t pos = __atomic_load_n(&g_head, __ATOMIC_RELAXED);
+    Slot* slot;
+    while (true) {
+        slot = &g_ring[pos & (RING_SIZE - 1)];
+        size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq == pos) {
+            if (__atomic_compare_exchange_n(&g_head, &pos, pos + 1, false,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (seq < pos) {
+            return false;   // full
+        } else {
+            pos = __atomic_load_n(&g_head, __ATOMIC_RELAXED);
+        }
+    }
+    if (len > SLOT_TEXT)
+        len = SLOT_TEXT;
+    slot->level = static_cast<unsigned char>(level);
+    slot->len = static_cast<unsigned short>(len);
+    std::memcpy(slot->text, text, len);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Moves everything currently in the ring to stdout/stderr, one write()
+// per stream and batch. Returns the number of lines written.
+size_t drain() {
+    static char out[64 * 1024];
+    static char err[16 * 1024];
+    size_t outLen = 0, errLen = 0, lines = 0;
+
+    while (true) {
+        Slot* slot = &g_ring[g_tail & (RING_SIZE - 1)];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != g_tail + 1)
+            break;
+        bool toErr = slot->level <= Log::WARN;
+        char* buf = toErr ? err : out;
+        size_t& len = toErr ? errLen : outLen;
+        size_t cap = toErr ? sizeof(err) : sizeof(out);
+        if (len + slot->len > cap) {
+            writeAll(toErr ? 2 : 1, buf, len);
+            len = 0;
+        }
+        std::memcpy(buf + len, slot->text, slot->len);
+        len += slot->len;
+        __atomic_store_n(&slot->seq, g_tail + RING_SIZE, __ATOMIC_RELEASE);
+        ++g_tail;
+        ++lines;
+    }
+    unsigned long dropped = __atomic_exchange_n(&g_dropped, 0UL, __ATOMIC_RELAXED);
+    if (dropped) {
+        char note[64];
+        int n = snprintf(note, sizeof(note), "log: %lu lines dropped\n", dropped);
+        if (errLen + n > sizeof(err)) {
+            writeAll(2, err, errLen);
+            errLen = 0;
+        }
+        std::memcpy(err + errLen, note, n);
+        errLen += n;
+    }
+    if (errLen)
+        writeAll(2, err, errLen);
+    if (outLen)
+        writeAll(1, out, outLen);
+    return lines;
+}
+
+bool ringEmpty() {
+    const Slot* slot = &g_ring[g_tail & (RING_SIZE - 1)];
+    return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != g_tail + 1;
+}
+
+// Wakes the flusher if it is asleep. Only the push that finds it asleep
+// (the ring going from empty to non-empty) pays for the signal. Both sides
+// exchange g_sleeping, so whichever goes second sees the other's update:
+// either this push sees the flag, or the flusher sees this push.
+void wakeFlusher() {
+    if (!__atomic_exchange_n(&g_sleeping, 0, __ATOMIC_ACQ_REL))
+        return;
+    pthread_mutex_lock(&g_wakeLock);
+    pthread_cond_signal(&g_wake);
+    pthread_mutex_unlock(&g_wakeLock);
+}
+
+void* flusherMain(void*) {
+    while (__atomic_load_n(&g_running, __ATOMIC_ACQUIRE)) {
+        if (drain() > 0)
+            continue;
+        pthread_mutex_lock(&g_wakeLock);
+        __atomic_exchange_n(&g_sleeping, 1, __ATOMIC_ACQ_REL);
+        // Re-check after announcing the sleep: a push that missed the flag
+        // is visible here, one that comes later sees it and signals.
+        if (ringEmpty() && __atomic_load_n(&g_running, __ATOMIC_ACQUIRE))
+            pthread_cond_wait(&g_wake, &g_wakeLock);
+        __atomic_store_n(&g_sleeping, 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&g_wakeLock);
+    }
+    return NULL;
+}
+
+} // namespace
+
+// --- Log
+
+Log::Level Log::_level = Log::INFO;
+
+void Log::start(Level level) {
+    _level = level;
+    for (size_t i = 0; i < RING_SIZE; ++i)
+        g_ring[i].seq = i;
+    g_head = 0;
+    g_tail = 0;
+    if (level == OFF)
+        return;
+    __atomic_store_n(&g_running, 1, __ATOMIC_RELEASE);
+    if (pthread_create(&g_flusher, NULL, flusherMain, NULL) != 0)
+        __atomic_store_n(&g_running, 0, __ATOMIC_RELEASE);  // stay synchronous
+}
+
+void Log::stop() {
+    if (__atomic_exchange_n(&g_running, 0, __ATOMIC_ACQ_REL)) {
+        pthread_mutex_lock(&g_wakeLock);
+        pthread_cond_signal(&g_wake);
+        pthread_mutex_unlock(&g_wakeLock);
+        pthread_join(g_flusher, NULL);
+    }
+    drain();
+}
+
+// Without a flusher (before start(), after stop(), or if the thread could
+// not be created) lines are written synchronously.
+void Log::write(Level level, const char* text, size_t len) {
+    if (!__atomic_load_n(&g_running, __ATOMIC_ACQUIRE)) {
+        writeAll(level <= WARN ? 2 : 1, text, len);
+        return;
+    }
+    if (!push(level, text, len))
+        __atomic_add_fetch(&g_dropped, 1UL, __ATOMIC_RELAXED);
+    wakeFlusher();
+}
+
+bool Log::parseLevel(const std::string& name, Level& out) {
+    static const char* names[] = { "off", "error", "warn", "info", "debug" };
+    for (int i = OFF; i <= DEBUG; ++i) {
+        if (name == names[i]) {
+            out = static_cast<Level>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// --- LogLine
+
+LogLine::LogLine(Log::Level level) : _level(level), _len(0) {}
+
+LogLine::~LogLine() {
+    _buf[_len++] = '\n';    // append() always leaves room
+    Log::write(_level, _buf, _len);
+}
+
+void LogLine::append(const char* data, size_t size) {
+    size_t room = TEXT_MAX - 1 - _len;
+    if (size > room)
+        size = room;
+    std::memcpy(_buf + _len, data, size);
+    _len += size;
+}
+
+LogLine& LogLine::operator<<(const char* s) {
+    append(s, std::strlen(s));
+    return *this;
+}
+
+LogLine& LogLine::operator<<(const std::string& s) {
+    append(s.data(), s.size());
+    return *this;
+}
+
+LogLine& LogLine::operator<<(const StringView& s) {
+    append(s.data(), s.size());
+    return *this;
+}
+
+LogLine& LogLine::operator<<(char c) {
+    append(&c, 1);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(int n) {
+    return *this << static_cast<long>(n);
+}
+
+LogLine& LogLine::operator<<(unsigned n) {
+    return *this << static_cast<unsigned long>(n);
+}
+
+LogLine& LogLine::operator<<(long n) {
+    char tmp[24];
+    int len = snprintf(tmp, sizeof(tmp), "%ld", n);
+    append(tmp, len);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(unsigned long n) {
+    char tmp[24];
+    int len = snprintf(tmp, sizeof(tmp), "%lu", n);
+    append(tmp, len);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(unsigned long long n) {
+    char tmp[24];
+    int len = snprintf(tmp, sizeof(tmp), "%llu", n);
+    append(tmp, len);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(double d) {
+    char tmp[32];
+    int len = snprintf(tmp, sizeof(tmp), "%g", d);
+    append(tmp, len);
+    return *this;
+}
@@ -0,0 +1,68 @@
+#ifndef LOG_HPP
+#define LOG_HPP
+
+#include <string>
+#include <cstddef>
+#include "StringView.hpp"
+
+// Asynchronous logging. A line is formatted into a fixed buffer on the
+// caller's stack and copied into a lock-free ring; a background thread
+// batches the ring out with one write() per burst, so the network path
+// never blocks on a slow terminal or pipe. When the ring is full lines are
+// dropped (and counted), never waited for. The flusher sleeps while the
+// ring is empty and is not started at all when logging is off.
+//
+//     IRC_LOG(Log::INFO) << "Client quit (fd=" << fd << ")";
+//
+// A disabled level costs one comparison: the operands are not evaluated.
+// ERROR and WARN lines go to stderr, the rest to stdout.
+class Log {
+public:
+    enum Level { OFF = 0, ERROR, WARN, INFO, DEBUG };
+
+    static bool enabled(Level level) { return level <= _level; }
+
+    static void start(Level level);     // spawns the flusher thread
+    static void stop();                 // drains the ring and joins
+    static void write(Level level, const char* text, size_t len);
+
+    // "off", "error", "warn", "info" or "debug"; false if unknown.
+    static bool parseLevel(const std::string& name, Level& out);
+
+private:
+    static Level _level;
+};
+
+// One log line, submitted when it goes out of scope.
+class LogLine {
+private:
+    static const size_t TEXT_MAX = 240;     // newline included
+
+    Log::Level  _level;
+    size_t      _len;
+    char        _buf[TEXT_MAX];
+
+    void append(const char* data, size_t size);
+    LogLine(const LogLine&);
+    LogLine& operator=(const LogLine&);
+
+public:
+    explicit LogLine(Log::Level level);
+    ~LogLine();
+
+    LogLine& operator<<(const char* s);
+    LogLine& operator<<(const std::string& s);
+    LogLine& operator<<(const StringView& s);
+    LogLine& operator<<(char c);
+    LogLine& operator<<(int n);
+    LogLine& operator<<(unsigned n);
+    LogLine& operator<<(long n);
+    LogLine& operator<<(unsigned long n);
+    LogLine& operator<<(unsigned long long n);
+    LogLine& operator<<(double d);
+};
+
+#define IRC_LOG(level) \
+    if (!Log::enabled(level)) {} else LogLine(level)
+
+#endif
@@ -0,0 +1,76 @@
+#include "Mailbox.hpp"
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <stdexcept>
+
+Mailbox::Mailbox() : _wakeRead(-1), _wakeWrite(-1), _wakePending(0) {
+    int fds[2];
+    if (pipe(fds) < 0)
+        throw std::runtime_error("Failed to create wake pipe");
+    _wakeRead = fds[0];
+    _wakeWrite = fds[1];
+    for (int i = 0; i < 2; ++i) {
+        if (fcntl(fds[i], F_SETFL, O_NONBLOCK) < 0 || fcntl(fds[i], F_SETFD, FD_CLOEXEC) < 0)
+            throw std::runtime_error("Failed to set non-blocking mode");
+    }
+}
+
+Mailbox::~Mailbox() {
+    close(_wakeRead);
+    close(_wakeWrite);
+}
+
+void Mailbox::postFlush(int fd, bool wake) {
+    _flush.push(fd);
+    if (wake)
+        this->wake();
+}
+
+void Mailbox::postRemoval(int fd, bool wake) {
+    _removal.push(fd);
+    if (wake)
+        this->wake();
+}
+
+void Mailbox::wake() {
+    if (__atomic_exchange_n(&_wakePending, 1, __ATOMIC_ACQ_REL))
+        return;     // already signalled, owner has not run yet
+    char byte = 1;
+    while (write(_wakeWrite, &byte, 1) < 0 && errno == EINTR) {}
+}
+
+bool Mailbox::popFlush(int& fd) {
+    return _flush.pop(fd);
+}
+
+bool Mailbox::popRemoval(int& fd) {
+    return _removal.pop(fd);
+}
+
+bool Mailbox::empty() const {
+    return _flush.empty() && _removal.empty();
+}
+
+int Mailbox::wakeFd() const {
+    return _wakeRead;
+}
+
+// Empties the pipe before re-arming wake(). A post that lands after the
+// drain either finds the flag still set and skips the write, or finds it
+// cleared and writes a fresh byte; in both cases the owner checks the
+// queues right after this call, so nothing is missed. Clearing first
+// would let a racing byte be drained with the flag left set, silencing
+// every later wake().
+void Mailbox::clearWake() {
+    char buf[64];
+    while (true) {
+        ssize_t n = read(_wakeRead, buf, sizeof(buf));
+        if (n > 0)
+            continue;
+        if (n < 0 && errno == EINTR)
+            continue;
+        break;
+    }
+    __atomic_store_n(&_wakePending, 0, __ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,38 @@
+#ifndef MAILBOX_HPP
+#define MAILBOX_HPP
+
+#include "MpscQueue.hpp"
+
+// Deferred work addressed to one worker thread: clients to flush and
+// clients to disconnect, by fd. Any thread may post; only the owning
+// worker drains. Posts from other threads also write to a wake pipe
+// registered in the owner's event loop, at most once until the owner
+// calls clearWake().
+class Mailbox {
+private:
+    MpscQueue<int>  _flush;
+    MpscQueue<int>  _removal;
+    int             _wakeRead;
+    int             _wakeWrite;
+    int             _wakePending;   // accessed atomically
+
+    Mailbox(const Mailbox&);
+    Mailbox& operator=(const Mailbox&);
+
+public:
+    Mailbox();
+    ~Mailbox();
+
+    void postFlush(int fd, bool wake);
+    void postRemoval(int fd, bool wake);
+    void wake();
+
+    // Owner thread only.
+    bool popFlush(int& fd);
+    bool popRemoval(int& fd);
+    bool empty() const;
+    int wakeFd() const;
+    void clearWake();
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "Message.hpp"
+#include <cstring>
+#include <new>
+
+// --- Message
+
+Message::Message(size_t size) : _refs(1), _size(size) {}
+
+Message::~Message() {}
+
+Message* Message::create(const char* data, size_t size) {
+    void* mem = ::operator new(sizeof(Message) + size);
+    Message* msg = new (mem) Message(size);
+    if (size)
+        std::memcpy(reinterpret_cast<char*>(msg + 1), data, size);
+    return msg;
+}
+
+void Message::release() {
+    if (--_refs == 0) {
+        this->~Message();
+        ::operator delete(this);
+    }
+}
+
+// --- MessageRef
+
+MessageRef::MessageRef() : _msg(NULL) {}
+
+MessageRef::MessageRef(const std::string& line)
+    : _msg(Message::create(line.data(), line.size())) {}
+
+MessageRef::MessageRef(const char* data, size_t size)
+    : _msg(Message::create(data, size)) {}
+
+MessageRef::MessageRef(const MessageRef& other) : _msg(other._msg) {
+    if (_msg)
+        _msg->retain();
+}
+
+MessageRef& MessageRef::operator=(const MessageRef& other) {
+    if (other._msg)
+        other._msg->retain();
+    if (_msg)
+        _msg->release();
+    _msg = other._msg;
+    return *this;
+}
+
+MessageRef::~MessageRef() {
+    if (_msg)
+        _msg->release();
+}
+
+// --- MessageBuilder
+
+MessageBuilder::MessageBuilder() : _len(0) {}
+
+MessageBuilder::MessageBuilder(const StringView& prefix) : _len(0) {
+    append(prefix.data(), prefix.size());
+}
+
+void MessageBuilder::append(const char* data, size_t size) {
+    size_t room = MAX_LINE - 2 - _len;
+    if (size > room)
+        size = room;
+    std::memcpy(_buf + _len, data, size);
+    _len += size;
+}
+
+MessageBuilder& MessageBuilder::word(const StringView& text) {
+    if (_len)
+        append(" ", 1);
+    append(text.data(), text.size());
+    return *this;
+}
+
+MessageBuilder& MessageBuilder::trailing(const StringView& text) {
+    if (_len)
+        append(" :", 2);
+    else
+        append(":", 1);
+    append(text.data(), text.size());
+    return *this;
+}
+
+// append() always leaves room for the CRLF.
+MessageRef MessageBuilder::build() {
+    _buf[_len] = '\r';
+    _buf[_len + 1] = '\n';
+    return MessageRef(_buf, _len + 2);
+}
@@ -0,0 +1,75 @@
+#ifndef MESSAGE_HPP
+#define MESSAGE_HPP
+
+#include <string>
+#include <cstddef>
+#include "StringView.hpp"
+
+// Immutable, reference-counted wire line. A broadcast formats the line once
+// and every recipient's output queue holds a reference to the same block,
+// so fan-out to N members costs one allocation instead of N copies.
+// Header and payload live in a single allocation.
+class Message {
+private:
+    unsigned    _refs;
+    size_t      _size;
+
+    explicit Message(size_t size);
+    ~Message();
+    Message(const Message&);
+    Message& operator=(const Message&);
+
+public:
+    static Message* create(const char* data, size_t size);
+
+    const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+    size_t size() const { return _size; }
+
+    void retain() { ++_refs; }
+    void release();
+};
+
+// Owning handle to a Message; copying shares the block.
+class MessageRef {
+private:
+    Message* _msg;
+
+public:
+    MessageRef();
+    explicit MessageRef(const std::string& line);
+    MessageRef(const char* data, size_t size);
+    MessageRef(const MessageRef& other);
+    MessageRef& operator=(const MessageRef& other);
+    ~MessageRef();
+
+    const char* data() const { return _msg ? _msg->data() : ""; }
+    size_t size() const { return _msg ? _msg->size() : 0; }
+    bool empty() const { return size() == 0; }
+};
+
+// Formats one outbound line in a fixed buffer and turns it into a Message
+// with a single allocation:
+//
+//     MessageBuilder(client->getPrefix()).word("PART").word(name).trailing(reason).build()
+//
+// Words are separated by a space, trailing() adds " :text". Content past
+// the 512-byte IRC line limit is cut so the CRLF always fits.
+class MessageBuilder {
+private:
+    static const size_t MAX_LINE = 512;     // CRLF included
+
+    char    _buf[MAX_LINE];
+    size_t  _len;
+
+    void append(const char* data, size_t size);
+
+public:
+    MessageBuilder();
+    explicit MessageBuilder(const StringView& prefix);
+
+    MessageBuilder& word(const StringView& text);
+    MessageBuilder& trailing(const StringView& text);
+    MessageRef build();
+};
+
+#endif
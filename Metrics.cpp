@@ -0,0 +1,84 @@
+#include "Metrics.hpp"
+#include "Stats.hpp"
+#include "CommandTable.hpp"
+#include "ClientManager.hpp"
+#include "ChannelManager.hpp"
+#include "Client.hpp"
+#include <sstream>
+
+QueueGauges measureQueues(ClientManager& clients) {
+    QueueGauges g;
+    FdTable<Client*>& all = clients.getAllClients();
+    g.clients = all.size();
+    for (size_t i = 0; i < all.size(); ++i) {
+        unsigned long long queued = all.valueAt(i)->pendingOutputSize();
+        if (queued == 0)
+            continue;
+        ++g.backlogged;
+        g.queuedBytes += queued;
+        if (queued > g.maxQueued)
+            g.maxQueued = queued;
+    }
+    return g;
+}
+
+static void header(std::ostringstream& out, const char* name, const char* type, const char* help) {
+    out << "# HELP " << name << ' ' << help << '\n'
+        << "# TYPE " << name << ' ' << type << '\n';
+}
+
+static void metric(std::ostringstream& out, const char* name, const char* type,
+                   const char* help, unsigned long long value) {
+    header(out, name, type, help);
+    out << name << ' ' << value << '\n';
+}
+
+// Summary with fixed quantiles; scale converts recorded units (ns) to the
+// exported unit (seconds), or 1 for plain counts.
+static void summary(std::ostringstream& out, const char* name, const std::string& labels,
+                    const Histogram& h, double scale) {
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    std::string sep = labels.empty() ? "" : ",";
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); ++i) {
+        out << name << '{' << labels << sep << "quantile=\"" << quantiles[i] << "\"} "
+            << static_cast<double>(h.percentile(quantiles[i])) * scale << '\n';
+    }
+    std::string braces = labels.empty() ? "" : "{" + labels + "}";
+    out << name << "_sum" << braces << ' ' << static_cast<double>(h.sum()) * scale << '\n'
+        << name << "_count" << braces << ' ' << h.count() << '\n';
+}
+
+void renderMetrics(std::string& text, ClientManager& clients, ChannelManager& channels) {
+    const ServerStats& s = serverStats();
+    QueueGauges q = measureQueues(clients);
+    std::ostringstream out;
+
+    metric(out, "ircserv_uptime_seconds", "gauge", "Seconds since start.",
+           static_cast<unsigned long long>(time(NULL) - s.startedAt));
+    metric(out, "ircserv_clients", "gauge", "Connected clients.", q.clients);
+    metric(out, "ircserv_channels", "gauge", "Existing channels.", channels.getAllChannels().size());
+    metric(out, "ircserv_sendq_bytes", "gauge", "Output bytes queued across all clients.", q.queuedBytes);
+    metric(out, "ircserv_sendq_max_bytes", "gauge", "Deepest single client output queue.", q.maxQueued);
+    metric(out, "ircserv_sendq_clients", "gauge", "Clients with unsent output.", q.backlogged);
+    metric(out, "ircserv_messages_in_total", "counter", "Lines received.", s.messagesIn);
+    metric(out, "ircserv_bytes_in_total", "counter", "Bytes received.", s.bytesIn);
+    metric(out, "ircserv_messages_out_total", "counter", "Lines written.", s.messagesOut);
+    metric(out, "ircserv_bytes_out_total", "counter", "Bytes written.", s.bytesOut);
+    metric(out, "ircserv_writev_calls_total", "counter", "writev() calls on client sockets.", s.writeCalls);
+    metric(out, "ircserv_unknown_commands_total", "counter", "Lines with an unknown command.", s.unknownCommands);
+    metric(out, "ircserv_flood_throttled_total", "counter", "Times a client's input was held back by flood control.", s.floodThrottled);
+    metric(out, "ircserv_timeouts_total", "counter", "Connections closed by registration or ping timeout.", s.timedOut);
+    metric(out, "ircserv_accepts_total", "counter", "Connections accepted.", s.acceptsTotal);
+    metric(out, "ircserv_accept_wakeups_total", "counter", "Listener wakeups handled.", s.acceptWakeups);
+
+    header(out, "ircserv_command_duration_seconds", "summary", "Handler run time per command.");
+    for (size_t i = 0; i < commandCount(); ++i)
+        summary(out, "ircserv_command_duration_seconds",
+                std::string("command=\"") + commandAt(i).name + "\"", s.commandNs[i], 1e-9);
+    header(out, "ircserv_loop_busy_seconds", "summary", "Event loop iteration time, wakeup to idle.");
+    summary(out, "ircserv_loop_busy_seconds", "", s.loopBusyNs, 1e-9);
+    header(out, "ircserv_ready_fds", "summary", "Ready descriptors per event loop wakeup.");
+    summary(out, "ircserv_ready_fds", "", s.readyFds, 1.0);
+
+    text = out.str();
+}
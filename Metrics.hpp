@@ -0,0 +1,26 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <string>
+
+class ClientManager;
+class ChannelManager;
+
+// Output queue depth across all clients, measured on demand.
+struct QueueGauges {
+    size_t              clients;
+    size_t              backlogged;     // clients with unsent output
+    unsigned long long  queuedBytes;
+    unsigned long long  maxQueued;      // deepest single queue
+
+    QueueGauges() : clients(0), backlogged(0), queuedBytes(0), maxQueued(0) {}
+};
+
+// Walks every client; call with the state lock held.
+QueueGauges measureQueues(ClientManager& clients);
+
+// Prometheus text exposition (format 0.0.4) of ServerStats plus live
+// gauges. Nothing is computed until a scrape asks for it.
+void renderMetrics(std::string& out, ClientManager& clients, ChannelManager& channels);
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef MPSC_QUEUE_HPP
+#define MPSC_QUEUE_HPP
+
+#include <cstddef>
+
+// Unbounded multi-producer / single-consumer queue (Vyukov's linked
+// design). Producers swap themselves in at the head with one atomic
+// exchange and never block each other; the single consumer pops from the
+// tail. C++98 has no atomics, so the GCC/Clang __atomic builtins are used.
+//
+// A producer that has swapped the head but not yet linked its node makes
+// the queue look empty for a moment: consumers must be woken after push()
+// returns, never rely on seeing an item mid-push.
+template <typename T>
+class MpscQueue {
+private:
+    struct Node {
+        Node*           next;
+        T               value;
+        Node() : next(NULL), value() {}
+    };
+
+    Node*           _head;      // last pushed node, shared by producers
+    Node*           _tail;      // stub node owned by the consumer
+
+    MpscQueue(const MpscQueue&);
+    MpscQueue& operator=(const MpscQueue&);
+
+public:
+    MpscQueue() {
+        _tail = new Node();
+        _head = _tail;
+    }
+
+    ~MpscQueue() {
+        T drop;
+        while (pop(drop)) {}
+        delete _tail;
+    }
+
+    // Any thread.
+    void push(const T& value) {
+        Node* node = new Node();
+        node->value = value;
+        Node* prev = __atomic_exchange_n(&_head, node, __ATOMIC_ACQ_REL);
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+    }
+
+    // Consumer thread only.
+    bool pop(T& out) {
+        Node* tail = _tail;
+        Node* next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+        if (!next)
+            return false;
+        out = next->value;
+        _tail = next;
+        delete tail;
+        return true;
+    }
+
+    // Consumer thread only.
+    bool empty() const { return __atomic_load_n(&_tail->next, __ATOMIC_ACQUIRE) == NULL; }
+};
+
+#endif
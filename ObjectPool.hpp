@@ -0,0 +1,90 @@
+#ifndef OBJECT_POOL_HPP
+#define OBJECT_POOL_HPP
+
+#include <vector>
+#include <cstddef>
+#include <new>
+
+// Occupancy counters for one pool.
+struct PoolStats {
+    size_t  live;       // objects currently allocated
+    size_t  peak;       // highest live count seen
+    size_t  capacity;   // slots across all slabs
+    size_t  slabs;      // slabs obtained from the global allocator
+
+    PoolStats() : live(0), peak(0), capacity(0), slabs(0) {}
+};
+
+// Fixed-size slab allocator. Storage is taken from the global allocator a
+// slab of SlabSize objects at a time and freed slots are kept on an
+// intrusive free list, so a connection storm reuses the same memory
+// instead of hitting malloc for every object. Slabs are never returned.
+//
+// Classes opt in with member operator new/delete that forward here; the
+// pool only hands out raw storage, construction stays with `new T(...)`.
+template <typename T, size_t SlabSize = 64>
+class ObjectPool {
+private:
+    union Slot {
+        Slot*   next;
+        char    storage[sizeof(T)];
+        double  alignD;     // align like the most demanding scalar
+        void*   alignP;
+        long    alignL;
+    };
+
+    std::vector<Slot*>  _slabs;
+    Slot*               _free;
+    PoolStats           _stats;
+
+    ObjectPool(const ObjectPool&);
+    ObjectPool& operator=(const ObjectPool&);
+
+    void grow() {
+        Slot* slab = static_cast<Slot*>(::operator new(sizeof(Slot) * SlabSize));
+        _slabs.push_back(slab);
+        for (size_t i = SlabSize; i > 0; --i) {
+            slab[i - 1].next = _free;
+            _free = &slab[i - 1];
+        }
+        _stats.capacity += SlabSize;
+        ++_stats.slabs;
+    }
+
+public:
+    ObjectPool() : _free(NULL) {}
+
+    ~ObjectPool() {
+        for (size_t i = 0; i < _slabs.size(); ++i)
+            ::operator delete(_slabs[i]);
+    }
+
+    void* allocate(size_t size) {
+        if (size != sizeof(T))  // derived class: not ours to pool
+            return ::operator new(size);
+        if (!_free)
+            grow();
+        Slot* slot = _free;
+        _free = slot->next;
+        if (++_stats.live > _stats.peak)
+            _stats.peak = _stats.live;
+        return slot;
+    }
+
+    void deallocate(void* p, size_t size) {
+        if (!p)
+            return;
+        if (size != sizeof(T)) {
+            ::operator delete(p);
+            return;
+        }
+        Slot* slot = static_cast<Slot*>(p);
+        slot->next = _free;
+        _free = slot;
+        --_stats.live;
+    }
+
+    const PoolStats& stats() const { return _stats; }
+};
+
+#endif
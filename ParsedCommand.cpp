@@ -11,22 +11,121 @@
 /* ************************************************************************** */
 
 #include "ParsedCommand.hpp"
-#include "Client.hpp"
-#include <sstream>
 
-ParsedCommand::ParsedCommand(const std::string& rawCommand) {
-    std::istringstream iss(rawCommand);
-    iss >> command;
-    std::getline(iss, params);
-    if (!params.empty() && params[0] == ' ')
-        params.erase(0, 1);
+ParsedCommand::ParsedCommand() : _paramCount(0), _hasTrailing(false), _end(NULL) {}
+
+ParsedCommand::ParsedCommand(const StringView& rawCommand)
+    : _paramCount(0), _hasTrailing(false), _end(NULL) {
+    parse(rawCommand);
+}
+
+// Returns the end of the space-delimited word starting at p.
+static const char* wordEnd(const char* p, const char* end) {
+    while (p < end && *p != ' ')
+        ++p;
+    return p;
+}
+
+static const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && *p == ' ')
+        ++p;
+    return p;
+}
+
+void ParsedCommand::parse(const StringView& rawCommand) {
+    const char* p = rawCommand.data();
+    const char* end = p + rawCommand.size();
+    const char* w;
+
+    _tags = StringView();
+    _prefix = StringView();
+    _command = StringView();
+    _paramCount = 0;
+    _hasTrailing = false;
+    _end = end;
+
+    p = skipSpaces(p, end);
+    if (p < end && *p == '@') {
+        w = wordEnd(p, end);
+        _tags = StringView(p + 1, w - p - 1);
+        p = skipSpaces(w, end);
+    }
+    if (p < end && *p == ':') {
+        w = wordEnd(p, end);
+        _prefix = StringView(p + 1, w - p - 1);
+        p = skipSpaces(w, end);
+    }
+    w = wordEnd(p, end);
+    _command = StringView(p, w - p);
+    p = skipSpaces(w, end);
+
+    while (p < end && _paramCount < MAX_PARAMS) {
+        // The trailing parameter, and the 15th one, run to the end of line
+        if (*p == ':') {
+            _params[_paramCount++] = StringView(p + 1, end - p - 1);
+            _hasTrailing = true;
+            break;
+        }
+        if (_paramCount == MAX_PARAMS - 1) {
+            _params[_paramCount++] = StringView(p, end - p);
+            break;
+        }
+        w = wordEnd(p, end);
+        _params[_paramCount++] = StringView(p, w - p);
+        p = skipSpaces(w, end);
+    }
+}
+
+StringView ParsedCommand::getTags() const {
+    return _tags;
 }
 
-std::string ParsedCommand::getCommand() const {
-    return command;
+StringView ParsedCommand::getPrefix() const {
+    return _prefix;
 }
 
+StringView ParsedCommand::getCommand() const {
+    return _command;
+}
+
+size_t ParsedCommand::paramCount() const {
+    return _paramCount;
+}
+
+StringView ParsedCommand::param(size_t i) const {
+    if (i >= _paramCount)
+        return StringView();
+    return _params[i];
+}
+
+bool ParsedCommand::hasTrailing() const {
+    return _hasTrailing;
+}
+
+StringView ParsedCommand::restFrom(size_t i) const {
+    if (i >= _paramCount)
+        return StringView();
+    const char* begin = _params[i].data();
+    return StringView(begin, _end - begin);
+}
 
-std::string ParsedCommand::getParams() const {
-    return params;
-}
\ No newline at end of file
+// --- ListSplitter
+
+ListSplitter::ListSplitter(const StringView& list, char sep)
+    : _rest(list), _sep(sep), _done(list.empty()) {}
+
+bool ListSplitter::next(StringView& field) {
+    if (_done)
+        return false;
+    const char* p = _rest.data();
+    const char* end = p + _rest.size();
+    const char* q = p;
+    while (q < end && *q != _sep)
+        ++q;
+    field = StringView(p, q - p);
+    if (q == end)
+        _done = true;
+    else
+        _rest = StringView(q + 1, end - q - 1);
+    return true;
+}
@@ -15,17 +15,51 @@
 
 
 #include <string>
+#include "StringView.hpp"
 
+// Single-pass IRC line parser:
+//   [@tags SP] [:prefix SP] command *(SP param) [SP :trailing]
+// Every field is a view into the original line, so parsing never
+// allocates; the line must outlive the ParsedCommand.
 class ParsedCommand {
+public:
+    static const size_t MAX_PARAMS = 15;
+
 private:
-        std::string command;
-        std::string params;
+        StringView  _tags;
+        StringView  _prefix;
+        StringView  _command;
+        StringView  _params[MAX_PARAMS];
+        size_t      _paramCount;
+        bool        _hasTrailing;   // last param was introduced by ':'
+        const char* _end;           // end of the parsed line
 public:
-    ParsedCommand(const std::string& rawCommand);
-    std::string getCommand() const;
-    std::string getParams() const;
-};
+    ParsedCommand();
+    explicit ParsedCommand(const StringView& rawCommand);
+    void parse(const StringView& rawCommand);
 
-#endif
+    StringView getTags() const;
+    StringView getPrefix() const;
+    StringView getCommand() const;
+
+    size_t paramCount() const;
+    StringView param(size_t i) const;   // empty view when out of range
+    bool hasTrailing() const;
 
+    // Raw text from param i to the end of the line (params and separators
+    // included), for commands whose free-form text may lack a ':'.
+    StringView restFrom(size_t i) const;
+};
 
+// Iterates the fields of a separator-delimited list ("#a,#b,,#c").
+class ListSplitter {
+private:
+    StringView  _rest;
+    char        _sep;
+    bool        _done;
+public:
+    ListSplitter(const StringView& list, char sep = ',');
+    bool next(StringView& field);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include "PollLoop.hpp"
+
+static short toPollEvents(unsigned events) {
+    short ev = 0;
+    if (events & EventLoop::EV_READ)  ev |= POLLIN;
+    if (events & EventLoop::EV_WRITE) ev |= POLLOUT;
+    return ev;
+}
+
+PollLoop::PollLoop() {}
+
+PollLoop::~PollLoop() {}
+
+// poll() reports POLLHUP and POLLERR even for an empty event mask, so a
+// descriptor with no interest is parked as -1, which poll() skips, until
+// interest comes back.
+void PollLoop::add(int fd, unsigned events) {
+    struct pollfd p;
+    p.fd = events ? fd : -1;
+    p.events = toPollEvents(events);
+    p.revents = 0;
+    _fds.insert(fd, p);
+}
+
+void PollLoop::modify(int fd, unsigned events) {
+    pollfd* p = _fds.find(fd);
+    if (p) {
+        p->fd = events ? fd : -1;
+        p->events = toPollEvents(events);
+    }
+}
+
+void PollLoop::remove(int fd) {
+    _fds.erase(fd);
+}
+
+int PollLoop::wait(std::vector<IoEvent>& out, int timeoutMs) {
+    out.clear();
+    if (_fds.empty())
+        return 0;
+    pollfd* fds = _fds.data();
+    int ready = poll(fds, _fds.size(), timeoutMs);
+    if (ready <= 0)
+        return ready;
+    for (size_t i = 0; i < _fds.size() && static_cast<int>(out.size()) < ready; ++i) {
+        short re = fds[i].revents;
+        if (!re) continue;
+        IoEvent ev;
+        ev.fd = fds[i].fd;
+        ev.events = 0;
+        if (re & POLLIN)   ev.events |= EV_READ;
+        if (re & POLLOUT)  ev.events |= EV_WRITE;
+        if (re & (POLLERR | POLLNVAL)) ev.events |= EV_ERROR;
+        if (re & POLLHUP)  ev.events |= EV_HANGUP;
+        out.push_back(ev);
+    }
+    return static_cast<int>(out.size());
+}
+
+const char* PollLoop::name() const {
+    return "poll";
+}
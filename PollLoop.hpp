@@ -0,0 +1,30 @@
+#ifndef POLL_LOOP_HPP
+#define POLL_LOOP_HPP
+
+#include <poll.h>
+#include <vector>
+#include "EventLoop.hpp"
+#include "FdTable.hpp"
+
+// Portable poll() backend (level-triggered). Registrations live in an
+// FdTable so add/modify/remove are O(1); the dense pollfd array is passed
+// to poll() directly.
+class PollLoop : public EventLoop {
+private:
+    FdTable<pollfd> _fds;
+
+    PollLoop(const PollLoop&);
+    PollLoop& operator=(const PollLoop&);
+
+public:
+    PollLoop();
+    virtual ~PollLoop();
+
+    virtual void add(int fd, unsigned events);
+    virtual void modify(int fd, unsigned events);
+    virtual void remove(int fd);
+    virtual int  wait(std::vector<IoEvent>& out, int timeoutMs);
+    virtual const char* name() const;
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "RecvBuffer.hpp"
+#include <cstring>
+#include <string>
+
+RecvBuffer::RecvBuffer(size_t capacity, size_t lineMax)
+    : _buf(NULL), _capacity(capacity), _start(0), _end(0), _scan(0),
+      _lineEnd(std::string::npos), _next(0), _lineMax(lineMax),
+      _discarding(false), _overflows(0)
+{
+    if (_capacity <= _lineMax)
+        _capacity = _lineMax + 1;
+    _buf = new char[_capacity];
+}
+
+RecvBuffer::~RecvBuffer() {
+    delete[] _buf;
+}
+
+void RecvBuffer::compact() {
+    if (_start == 0)
+        return;
+    size_t len = _end - _start;
+    if (len)
+        std::memmove(_buf, _buf + _start, len);
+    _scan -= _start;
+    if (_lineEnd != std::string::npos) {
+        _lineEnd -= _start;
+        _next -= _start;
+    }
+    _end = len;
+    _start = 0;
+}
+
+char* RecvBuffer::writePtr() {
+    if (_end == _capacity)
+        compact();
+    return _buf + _end;
+}
+
+size_t RecvBuffer::writable() {
+    if (_end == _capacity)
+        compact();
+    return _capacity - _end;
+}
+
+void RecvBuffer::commit(size_t n) {
+    _end += n;
+}
+
+size_t RecvBuffer::append(const char* data, size_t n) {
+    size_t taken = 0;
+    while (taken < n) {
+        size_t room = writable();
+        if (room == 0)
+            break;      // full of unconsumed bytes
+        size_t chunk = n - taken < room ? n - taken : room;
+        std::memcpy(writePtr(), data + taken, chunk);
+        commit(chunk);
+        taken += chunk;
+    }
+    return taken;
+}
+
+// Looks for the next line end starting where the previous scan stopped,
+// dropping overlong lines on the way.
+bool RecvBuffer::hasLine() {
+    if (_lineEnd != std::string::npos)
+        return true;
+    while (_scan < _end) {
+        const char* nl = static_cast<const char*>(std::memchr(_buf + _scan, '\n', _end - _scan));
+        if (!nl) {
+            _scan = _end;
+            if (_discarding) {
+                _start = _scan;
+            } else if (_end - _start >= _lineMax) {
+                // No terminator within the limit: drop what we have and
+                // skip the remainder of the line as it arrives.
+                _discarding = true;
+                ++_overflows;
+                _start = _scan;
+            }
+            break;
+        }
+        size_t pos = nl - _buf;
+        _scan = pos + 1;
+        if (_discarding || pos + 1 - _start > _lineMax) {
+            if (!_discarding)
+                ++_overflows;
+            _discarding = false;
+            _start = _scan;
+            continue;
+        }
+        _lineEnd = (pos > _start && _buf[pos - 1] == '\r') ? pos - 1 : pos;
+        _next = pos + 1;
+        return true;
+    }
+    if (_start == _end) {
+        _start = 0;
+        _end = 0;
+        _scan = 0;
+    }
+    return false;
+}
+
+StringView RecvBuffer::peekLine() const {
+    return StringView(_buf + _start, _lineEnd - _start);
+}
+
+StringView RecvBuffer::popLine() {
+    StringView line(_buf + _start, _lineEnd - _start);
+    _start = _next;
+    _scan = _start;
+    _lineEnd = std::string::npos;
+    if (_start == _end) {
+        _start = 0;
+        _end = 0;
+        _scan = 0;
+    }
+    return line;
+}
+
+unsigned RecvBuffer::takeOverflows() {
+    unsigned n = _overflows;
+    _overflows = 0;
+    return n;
+}
+
+void RecvBuffer::clear() {
+    _start = 0;
+    _end = 0;
+    _scan = 0;
+    _lineEnd = std::string::npos;
+    _discarding = false;
+}
@@ -0,0 +1,59 @@
+#ifndef RECV_BUFFER_HPP
+#define RECV_BUFFER_HPP
+
+#include <cstddef>
+#include "StringView.hpp"
+
+// Fixed-capacity receive buffer. The socket is read straight into the free
+// tail, lines are found by an incremental scan that never revisits bytes,
+// and complete lines are handed out as views without copying. Consumed
+// bytes are reclaimed by sliding the (at most one) partial line back to
+// the front when the tail runs out, so there is no per-line erase.
+//
+// Lines end with "\n" (an optional preceding "\r" is stripped). A line
+// longer than the limit (terminator included, 512 per RFC 1459) is dropped
+// up to its terminator and counted as an overflow for the caller to report.
+class RecvBuffer {
+private:
+    char*   _buf;
+    size_t  _capacity;
+    size_t  _start;     // first unconsumed byte
+    size_t  _end;       // one past the last received byte
+    size_t  _scan;      // bytes in [_start, _scan) contain no line end
+    size_t  _lineEnd;   // end of the line found by hasLine(), npos if none
+    size_t  _next;      // start of the line after it
+    size_t  _lineMax;   // longest accepted line, terminator included
+    bool    _discarding;// dropping the rest of an overlong line
+    unsigned _overflows;// overlong lines dropped since takeOverflows()
+
+    RecvBuffer(const RecvBuffer&);
+    RecvBuffer& operator=(const RecvBuffer&);
+
+    void compact();
+
+public:
+    // capacity must exceed lineMax so a maximal line always fits.
+    RecvBuffer(size_t capacity, size_t lineMax);
+    ~RecvBuffer();
+
+    // Free space to read into; call commit() with the number of bytes read.
+    char*  writePtr();
+    size_t writable();
+    void   commit(size_t n);
+    // Copies as much of data as fits and returns the number of bytes
+    // taken; pop lines to make room for the rest.
+    size_t append(const char* data, size_t n);
+
+    bool hasLine();
+    StringView peekLine() const;    // requires hasLine(); leaves it queued
+    StringView popLine();           // requires hasLine()
+
+    // Number of overlong lines dropped since the last call.
+    unsigned takeOverflows();
+
+    size_t size() const { return _end - _start; }
+    size_t capacity() const { return _capacity; }
+    void   clear();
+};
+
+#endif
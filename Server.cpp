@@ -1,26 +1,81 @@
 #include "Server.hpp"
+#include "Stats.hpp"
+#include "ObjectPool.hpp"
+#include "Log.hpp"
+#include "Metrics.hpp"
+#include "Histogram.hpp"
+#include <sstream>
+#include <sys/time.h>
 
+// Read by every worker thread, cleared by the signal handler or a failing
+// worker: accessed through atomic builtins (lock-free, signal safe).
 static volatile sig_atomic_t g_running = 1;
 
+static bool server_running()
+{
+	return __atomic_load_n(&g_running, __ATOMIC_ACQUIRE) != 0;
+}
+
+static void stop_server()
+{
+	__atomic_store_n(&g_running, 0, __ATOMIC_RELEASE);
+}
+
 static void server_signal_handler(int sig)
 {
 	if (sig == SIGINT || sig == SIGTERM)
-		g_running = 0;
+		stop_server();
 }
 
-server::server(int port, const std::string& password)
+server::server(const ServerConfig& config)
 {
-	this->port = port;
-	this->password = password;
-	this->server_fd = -1;
+	this->port = config.port;
+	this->password = config.password;
+	this->backend = config.backend;
+	this->sendq = config.sendq;
+	this->recvq = config.recvq;
+	this->line_max = config.line_max;
+	this->listen_backlog = config.listen_backlog;
+	this->accept_batch = config.accept_batch;
+	this->thread_count = config.threads;
+	this->metrics_port = config.metrics_port;
+	this->line_budget = config.line_budget;
+	this->register_timeout = config.register_timeout;
+	this->ping_interval = config.ping_interval;
+	this->ping_timeout = config.ping_timeout;
+	this->flood_rate = config.flood_rate;
+	this->flood_burst = config.flood_burst;
+	this->metrics_fd = -1;
+	pthread_mutex_init(&state_lock, NULL);
 	client_manager = new ClientManager(this->password);
+	client_manager->setSendQLimit(this->sendq);
+	client_manager->setFloodLimits(this->flood_rate, this->flood_burst);
 	channel_manager = new ChannelManager();
 }
 server::server(const server& other)
 {
 	this->port = other.port;
 	this->password = other.password;
-	this->server_fd = other.server_fd;
+	this->backend = other.backend;
+	this->sendq = other.sendq;
+	this->recvq = other.recvq;
+	this->line_max = other.line_max;
+	this->listen_backlog = other.listen_backlog;
+	this->accept_batch = other.accept_batch;
+	this->thread_count = other.thread_count;
+	this->metrics_port = other.metrics_port;
+	this->line_budget = other.line_budget;
+	this->register_timeout = other.register_timeout;
+	this->ping_interval = other.ping_interval;
+	this->ping_timeout = other.ping_timeout;
+	this->flood_rate = other.flood_rate;
+	this->flood_burst = other.flood_burst;
+	this->metrics_fd = -1;
+	pthread_mutex_init(&state_lock, NULL);
+	client_manager = new ClientManager(this->password);
+	client_manager->setSendQLimit(this->sendq);
+	client_manager->setFloodLimits(this->flood_rate, this->flood_burst);
+	channel_manager = new ChannelManager();
 }
 server& server::operator=(const server& other)
 {
@@ -28,30 +83,54 @@ server& server::operator=(const server& other)
 	{
 		this->port = other.port;
 		this->password = other.password;
-		this->server_fd = other.server_fd;
+		this->backend = other.backend;
+		this->sendq = other.sendq;
+		this->recvq = other.recvq;
+		this->line_max = other.line_max;
+		this->listen_backlog = other.listen_backlog;
+		this->accept_batch = other.accept_batch;
+		this->thread_count = other.thread_count;
+		this->metrics_port = other.metrics_port;
+		this->line_budget = other.line_budget;
+		this->register_timeout = other.register_timeout;
+		this->ping_interval = other.ping_interval;
+		this->ping_timeout = other.ping_timeout;
+		this->flood_rate = other.flood_rate;
+		this->flood_burst = other.flood_burst;
 	}
 	return *this;
 }
 
 int server::create_socket()
 {
-	server_fd = socket(AF_INET, SOCK_STREAM, 0);
-	if (server_fd < 0){
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0){
 		throw std::runtime_error("Failed to create socket");
 	}
-	if (fcntl(server_fd, F_SETFL, O_NONBLOCK) < 0)
+	if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0)
         throw std::runtime_error("Failed to set non-blocking mode");
-	return server_fd;
+	return fd;
 }
-void  server::set_socket_options()
+// With several workers every one binds its own listener to the port and
+// the kernel spreads incoming connections across them (SO_REUSEPORT).
+void  server::set_socket_options(int fd)
 {
 	int opt = 1;
-	if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
 	{
 		throw std::runtime_error("Failed to set socket options");
 	}
+	if (thread_count > 1)
+	{
+#ifdef SO_REUSEPORT
+		if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
+			throw std::runtime_error("Failed to set SO_REUSEPORT");
+#else
+		throw std::runtime_error("IRCSERV_THREADS > 1 needs SO_REUSEPORT");
+#endif
+	}
 }
-void server::bind_socket()
+void server::bind_socket(int fd)
 {
 
 	struct sockaddr_in addr;
@@ -61,62 +140,456 @@ void server::bind_socket()
 	for (int i = 0; i < 8; ++i)
 		addr.sin_zero[i] = 0;
 
-	if (bind(server_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
 	{
 		throw std::runtime_error("Failed to bind socket");
 	}
 }
 
-void server::listen_socket()
+void server::listen_socket(int fd)
 {
-    if (listen(server_fd, SOMAXCONN) < 0)
+    if (listen(fd, listen_backlog) < 0)
     {
         throw std::runtime_error("Failed to listen on socket");
     }
-    std::cout << "Server is now listening for connections..." << std::endl;
 }
 
-void server::setup_poll()
+void server::setup_event_loop(Reactor &r)
+{
+	r.loop = EventLoop::create(backend);
+	r.loop->add(r.listen_fd, EventLoop::EV_READ);
+	r.loop->add(r.mailbox.wakeFd(), EventLoop::EV_READ);
+}
+
+// Single-threaded mode skips the mutex entirely. The lock holder is
+// recorded so deferred work it posts for other workers wakes them.
+void server::lock_state(Reactor &r)
 {
-	struct pollfd p;
-	p.fd = server_fd;
-	p.events = POLLIN;
-	p.revents = 0;
-	poll_fds.push_back(p);
+	if (thread_count > 1)
+		pthread_mutex_lock(&state_lock);
+	client_manager->setCurrentWorker(r.index);
 }
 
-void server::accept_new_client()
+void server::unlock_state()
 {
-	struct sockaddr_in client_addr;
-	socklen_t len = sizeof(client_addr);
+	if (thread_count > 1)
+		pthread_mutex_unlock(&state_lock);
+}
 
-	int client_fd = accept(server_fd, (struct sockaddr*)&client_addr, &len);
-	if (client_fd < 0)
+// Accepts until the queue is empty, but at most accept_batch connections
+// per loop iteration so a reconnect storm cannot starve established
+// clients. The listener is edge-triggered under epoll and will not signal
+// again for connections already queued: accept_pending makes run_worker()
+// come back for them on the next iteration.
+void server::accept_new_client(Reactor &r)
+{
+	std::vector<std::pair<int, struct sockaddr_in> > accepted;
+	r.accept_pending = false;
+	while (true)
 	{
-		// Don't throw on EAGAIN (normal for non-blocking)
-		if (errno == EAGAIN)
-			return;
-		std::cerr << "accept() failed: " << strerror(errno) << std::endl;
+		if (accepted.size() == accept_batch)
+		{
+			r.accept_pending = true;
+			break;
+		}
+		struct sockaddr_in client_addr;
+		socklen_t len = sizeof(client_addr);
+
+#ifdef __linux__
+		int client_fd = accept4(r.listen_fd, (struct sockaddr*)&client_addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+		int client_fd = accept(r.listen_fd, (struct sockaddr*)&client_addr, &len);
+#endif
+		if (client_fd < 0)
+		{
+			// Don't throw on EAGAIN (normal for non-blocking)
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			IRC_LOG(Log::ERROR) << "accept() failed: " << strerror(errno);
+			break;
+		}
+#ifndef __linux__
+		if (fcntl(client_fd, F_SETFL, O_NONBLOCK) < 0 || fcntl(client_fd, F_SETFD, FD_CLOEXEC) < 0)
+			throw std::runtime_error("Failed to set non-blocking mode");
+#endif
+		accepted.push_back(std::make_pair(client_fd, client_addr));
+	}
+
+	// Register the whole batch under one lock, then start polling it
+	lock_state(r);
+	for (size_t i = 0; i < accepted.size(); ++i)
+	{
+		int client_fd = accepted[i].first;
+		Client *client = new Client(client_fd, recvq, line_max);
+		client->setOwner(r.index);
+		client_manager->addClient(client);
+		r.clients.insert(client_fd, client);
+		start_timers(r, client);
+		char	ip[INET_ADDRSTRLEN];
+		if (inet_ntop(AF_INET, &(accepted[i].second.sin_addr), ip, sizeof(ip)) != NULL)
+		{
+			IRC_LOG(Log::INFO) << "New connection from " << ip << ":" << ntohs(accepted[i].second.sin_port) << " (fd=" << client_fd << ")";
+		}
+		else
+		{
+			IRC_LOG(Log::INFO) << "New connection (fd=" << client_fd << ")";
+		}
+	}
+	serverStats().recordAcceptWakeup(accepted.size());
+	unlock_state();
+	for (size_t i = 0; i < accepted.size(); ++i)
+		r.loop->add(accepted[i].first, EventLoop::EV_READ);
+}
+
+// Announces the departure to every channel the client is on, then drops it
+// from the event loop and the client manager (which closes the socket).
+// Runs on the owning worker with the state lock held.
+void server::remove_client(Reactor &r, int fd)
+{
+	Client** slot = r.clients.find(fd);
+	if (!slot)
+		return;
+	Client* client = *slot;
+	// A stale request must not hit a newer connection reusing the fd
+	if (!client->shouldQuit())
+		return;
+	MessageBuilder quitLine(client->getPrefix());
+	quitLine.word("QUIT");
+	if (!client->getQuitReason().empty())
+		quitLine.trailing(client->getQuitReason());
+	client->sendToCommonPeers(quitLine.build(), false);
+	// Walk a copy: removeMember updates the client's channel list
+	std::vector<Channel*> joined(client->getChannels());
+	for (size_t i = 0; i < joined.size(); ++i)
+		joined[i]->removeMember(fd, client_manager, true);
+	// Last chance for anything still queued (e.g. the QUIT echo)
+	if (client->hasPendingOutput())
+		client->flushSend();
+	r.loop->remove(fd);
+	r.clients.erase(fd);
+	r.held.erase(fd);
+	r.timers.cancel(client->livenessTimer());
+	r.timers.cancel(client->floodTimer());
+	client_manager->removeClient(fd);
+	IRC_LOG(Log::INFO) << "Client quit (fd=" << fd << ")";
+}
+
+// Event mask for a connection: readable unless its input is held back,
+// writable while output is backlogged.
+static unsigned interest(const Client *client)
+{
+	return (client->isReadPaused() ? 0 : EventLoop::EV_READ)
+		| (client->isWriteArmed() ? EventLoop::EV_WRITE : 0);
+}
+
+// State lock held: takes the client's queued output and lines it up for
+// write_flushing().
+void server::flush_client(Reactor &r, Client *client)
+{
+	client->clearFlushScheduled();
+	if (client->shouldQuit() && !client->hasPendingOutput())
+		return;
+	client->takeOutput();
+	r.flushing.push_back(client);
+}
+
+// State lock held on entry and exit. The writev() calls run with the lock
+// released: the taken output, the socket and the write cursor belong to
+// this worker, and only the owner ever removes a client, so the pointers
+// stay valid. Results are applied under the lock again: written messages
+// are released, and the event loop is asked for writability only while a
+// backlog remains.
+void server::write_flushing(Reactor &r)
+{
+	if (r.flushing.empty())
+		return;
+	r.flushResults.resize(r.flushing.size());
+	unlock_state();
+	for (size_t i = 0; i < r.flushing.size(); ++i)
+		r.flushResults[i] = r.flushing[i]->writeOutput();
+	lock_state(r);
+	for (size_t i = 0; i < r.flushing.size(); ++i)
+	{
+		Client *client = r.flushing[i];
+		client->settleOutput();
+		if (r.flushResults[i] == Client::FLUSH_ERROR) {
+			client->markForQuit("Write error");
+			continue;
+		}
+		bool wantWrite = (r.flushResults[i] == Client::FLUSH_PENDING);
+		if (wantWrite != client->isWriteArmed()) {
+			client->setWriteArmed(wantWrite);
+			r.loop->modify(client->getFd(), interest(client));
+		}
+	}
+	r.flushing.clear();
+}
+
+// Runs after each batch of events with the state lock held (released around
+// the socket writes): disconnects clients marked for removal and flushes
+// freshly queued output. Either step can schedule more of the other (QUIT
+// broadcasts, write errors), so repeat until the mailbox is empty.
+void server::run_deferred_work(Reactor &r)
+{
+	int fd;
+	while (!r.mailbox.empty())
+	{
+		while (r.mailbox.popRemoval(fd))
+			remove_client(r, fd);
+		while (r.mailbox.popFlush(fd)) {
+			Client** slot = r.clients.find(fd);
+			if (slot)
+				flush_client(r, *slot);
+		}
+		write_flushing(r);
+	}
+}
+
+// The socket, its receive buffer and flood bucket belong to this worker, so
+// recv(), line parsing and flood accounting run without the state lock;
+// only command execution takes it.
+// Reads and runs input under two limits: at most line_budget lines per
+// call, so one busy connection cannot hold up the rest of the batch, and the
+// client's flood bucket. Whatever is left is marked in r.held and resumes
+// on the next iteration (budget) or when the flood timer fires. While lines are held the socket is read only
+// until the buffer is full; the kernel queue then pushes back on the sender.
+void server::read_from_client(Reactor &r, int fd)
+{
+	Client** slot = r.clients.find(fd);
+	if (!slot)
+	{
+		IRC_LOG(Log::WARN) << "No client found for fd " << fd;
+		r.loop->remove(fd);
 		return;
 	}
-	if (fcntl(client_fd, F_SETFL, O_NONBLOCK) < 0)
-        throw std::runtime_error("Failed to set non-blocking mode");
-	//add client to poll_fds
-	struct pollfd p;
-	p.fd = client_fd;
-	p.events = POLLIN;
-	p.revents = 0;
-	poll_fds.push_back(p);
-	client_manager->addClient(new Client(client_fd));
-	char	ip[INET_ADDRSTRLEN];
-	if (inet_ntop(AF_INET, &(client_addr.sin_addr), ip, sizeof(ip)) != NULL)
+	read_input(r, *slot);
+	watch_input(r, *slot);
+}
+
+// Stops watching a held connection for input: the unread data keeps a
+// level-triggered poll() reporting it readable, which would spin the loop
+// until the connection's turn comes. Reads are watched again once nothing
+// is held.
+void server::watch_input(Reactor &r, Client *client)
+{
+	bool pause = r.held.contains(client->getFd());
+	if (pause != client->isReadPaused()) {
+		client->setReadPaused(pause);
+		r.loop->modify(client->getFd(), interest(client));
+	}
+}
+
+void server::read_input(Reactor &r, Client *client)
+{
+	int fd = client->getFd();
+	r.held.erase(fd);
+	RecvBuffer& input = client->getRecvBuffer();
+	unsigned budget = line_budget;
+	ssize_t bytes = 0;
+	while (true)
+	{
+		if (bytes > 0)
+			input.commit(static_cast<size_t>(bytes));
+		r.input.clear();
+		Client::InputResult result = client->takeInput(budget, r.input);
+		lock_state(r);
+		if (bytes > 0)
+			serverStats().bytesIn += bytes;
+		client->runInput(r.input, channel_manager, client_manager);
+		bool quitting = client->shouldQuit();
+		if (client->livenessTimer().kind == TIMER_REGISTRATION && client->isRegistered())
+			start_keepalive(r, client);
+		if (result == Client::INPUT_THROTTLED)
+		{
+			r.held.insert(fd, 1);
+			r.timers.arm(client->floodTimer(), client->inputReadyAt());
+		}
+		else if (result == Client::INPUT_BUDGET && !r.held.contains(fd))
+		{
+			r.held.insert(fd, 1);
+			r.runnable.push_back(fd);
+		}
+		unlock_state();
+		// Stop at QUIT; removal happens once the event batch is done
+		if (quitting)
+			return;
+		// Data is received straight into the client's buffer.
+		size_t room = input.writable();
+		if (room == 0)
+			return;
+		bytes = recv(fd, input.writePtr(), room, 0);
+		if (bytes < 0)
+		{
+			// Drained until EAGAIN, as the edge-triggered backend requires
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return;
+			if (errno == EINTR)
+			{
+				bytes = 0;
+				continue;
+			}
+		}
+		// End of input: held lines still run first, recv() reports the
+		// close again when they are done.
+		if (bytes == 0 && result != Client::INPUT_DRAINED)
+			return;
+		if (bytes <= 0)
+		{
+			lock_state(r);
+			IRC_LOG(Log::INFO) << "Client disconnected (fd=" << fd << ")";
+			client->markForQuit();
+			unlock_state();
+			return;
+		}
+	}
+}
+
+// Resumes connections held by the line budget, with a fresh budget. Runs
+// before the new events of an iteration so such a connection gets one turn
+// per wakeup. The list is swapped out first: read_from_client() refills it.
+void server::run_deferred_input(Reactor &r)
+{
+	std::vector<int> due;
+	due.swap(r.runnable);
+	for (size_t i = 0; i < due.size(); ++i)
 	{
-		 std::cout << "New connection from " << ip << ":" << ntohs(client_addr.sin_port) << " (fd=" << client_fd << ")\n";
+		if (r.held.contains(due[i]))
+			read_from_client(r, due[i]);
 	}
+}
+
+// Every connection carries two timers in its Client: the liveness timer
+// (registration deadline, then keepalive) and the flood timer. Both live in
+// the worker's wheel, so there is no per-connection timer syscall and
+// arming or cancelling is O(1).
+void server::start_timers(Reactor &r, Client *client)
+{
+	unsigned long long now = monotonicNanos();
+	Timer &live = client->livenessTimer();
+	live.fd = client->getFd();
+	client->floodTimer().fd = client->getFd();
+	client->floodTimer().kind = TIMER_FLOOD;
+	live.kind = TIMER_REGISTRATION;
+	if (register_timeout)
+		r.timers.arm(live, now + register_timeout * 1000000000ULL);
+	else
+		start_keepalive(r, client);
+}
+
+// Called once registration completes (or right away without a deadline).
+void server::start_keepalive(Reactor &r, Client *client)
+{
+	Timer &live = client->livenessTimer();
+	live.kind = TIMER_KEEPALIVE;
+	if (ping_interval)
+		r.timers.arm(live, client->lastActivity() + ping_interval * 1000000000ULL);
 	else
+		r.timers.cancel(live);
+}
+
+// Keepalive is lazy: lines only record their time, and the timer, when it
+// fires, re-arms itself from the last activity until the client has been
+// quiet for a whole ping_interval. Any line after the PING counts as the
+// answer.
+void server::check_liveness(Reactor &r, Client *client, Timer &t)
+{
+	if (client->shouldQuit())
+		return;
+	unsigned long long now = monotonicNanos();
+	unsigned long long interval = ping_interval * 1000000000ULL;
+	unsigned long long idle = now - client->lastActivity();
+	const char *reason = NULL;
+	switch (t.kind)
+	{
+	case TIMER_REGISTRATION:
+		if (!client->isRegistered())
+		{
+			reason = "Registration timed out";
+			break;
+		}
+		start_keepalive(r, client);
+		return;
+	case TIMER_KEEPALIVE:
+		if (idle < interval)
+		{
+			r.timers.arm(t, client->lastActivity() + interval);
+			return;
+		}
+		client->queueSend(std::string("PING :localhost\r\n"));
+		t.kind = TIMER_PING_TIMEOUT;
+		r.timers.arm(t, now + ping_timeout * 1000000000ULL);
+		return;
+	case TIMER_PING_TIMEOUT:
+		if (idle < ping_timeout * 1000000000ULL)
+		{
+			t.kind = TIMER_KEEPALIVE;
+			r.timers.arm(t, client->lastActivity() + interval);
+			return;
+		}
+		reason = "Ping timeout";
+		break;
+	}
+	if (!reason)
+		return;
+	IRC_LOG(Log::INFO) << reason << " (fd=" << client->getFd() << ")";
+	++serverStats().timedOut;
+	client->queueSend(std::string("ERROR :Closing link (") + reason + ")\r\n");
+	client->markForQuit(reason);
+}
+
+void server::run_timers(Reactor &r)
+{
+	r.expired.clear();
+	r.timers.advance(monotonicNanos(), r.expired);
+	for (size_t i = 0; i < r.expired.size(); ++i)
 	{
-		std::cout << "New connection (fd=" << client_fd << ")\n";
+		Timer *t = r.expired[i];
+		if (t->kind == TIMER_SCRAPE)
+		{
+			close_scrape(r, t->fd);
+			continue;
+		}
+		Client** slot = r.clients.find(t->fd);
+		if (!slot)
+			continue;
+		if (t->kind == TIMER_FLOOD)
+		{
+			if (r.held.contains(t->fd))
+				read_from_client(r, t->fd);
+			continue;
+		}
+		lock_state(r);
+		check_liveness(r, *slot, *t);
+		unlock_state();
+	}
+}
+
+// Don't block while accepted connections or budget-held input are waiting;
+// otherwise sleep until the next timer.
+int server::loop_timeout(Reactor &r)
+{
+	if (r.accept_pending || !r.runnable.empty())
+		return 0;
+	return r.timers.timeoutMs(monotonicNanos());
+}
+
+void server::handle_client_event(Reactor &r, const IoEvent &ev)
+{
+	Client** slot = r.clients.find(ev.fd);
+	if (slot && (ev.events & EventLoop::EV_WRITE)) {
+		lock_state(r);
+		flush_client(r, *slot);
+		write_flushing(r);
+		unlock_state();
 	}
+	// Errors and hangups are reported by recv() returning 0 or -1, after any
+	// data the peer sent before closing has been processed. A connection
+	// with held input is read when its turn comes (budget or flood timer).
+	if ((ev.events & (EventLoop::EV_READ | EventLoop::EV_HANGUP | EventLoop::EV_ERROR))
+		&& !r.held.contains(ev.fd))
+		read_from_client(r, ev.fd);
 }
 
 void	server::setup()
@@ -125,146 +598,293 @@ void	server::setup()
     signal(SIGINT, server_signal_handler);
     signal(SIGTERM, server_signal_handler);
     signal(SIGPIPE, SIG_IGN);
-	create_socket();
-	set_socket_options();
-	bind_socket();
-	listen_socket();
-	std::cout << "Server started on port " << port << std::endl;
+	std::vector<Mailbox*> mailboxes;
+	for (int i = 0; i < thread_count; ++i)
+	{
+		Reactor *r = new Reactor();
+		r->index = i;
+		r->owner = this;
+		reactors.push_back(r);
+		mailboxes.push_back(&r->mailbox);
+		r->listen_fd = create_socket();
+		set_socket_options(r->listen_fd);
+		bind_socket(r->listen_fd);
+		listen_socket(r->listen_fd);
+		setup_event_loop(*r);
+	}
+	client_manager->setMailboxes(mailboxes);
+	if (metrics_port)
+		setup_metrics();
+	IRC_LOG(Log::INFO) << "Server is now listening for connections...";
+	if (thread_count > 1) {
+		IRC_LOG(Log::INFO) << "Using " << reactors[0]->loop->name() << " event loop on " << thread_count << " worker threads";
+	} else {
+		IRC_LOG(Log::INFO) << "Using " << reactors[0]->loop->name() << " event loop";
+	}
+	IRC_LOG(Log::INFO) << "Server started on port " << port;
 }
 
-void server::run()
+// The admin endpoint only listens on loopback: scrapers run on the host.
+void server::setup_metrics()
+{
+	metrics_fd = create_socket();
+	int opt = 1;
+	if (setsockopt(metrics_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+		throw std::runtime_error("Failed to set socket options");
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(metrics_port);
+	if (bind(metrics_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+		throw std::runtime_error("Failed to bind metrics socket");
+	if (listen(metrics_fd, 16) < 0)
+		throw std::runtime_error("Failed to listen on metrics socket");
+	reactors[0]->loop->add(metrics_fd, EventLoop::EV_READ);
+	IRC_LOG(Log::INFO) << "Metrics on http://127.0.0.1:" << metrics_port << "/metrics";
+}
+
+// Accepts pending scrapes onto worker 0's event loop. Each one gets a
+// single deadline for the whole exchange, so a slow or stalled peer costs
+// one idle socket, never worker time.
+void server::serve_metrics()
 {
-	setup_poll();
-	std::cout << "Server running on port " << port << std::endl;
+	Reactor &r = *reactors[0];
+	while (true)
+	{
+		int fd = accept(metrics_fd, NULL, NULL);
+		if (fd < 0)
+			return;
+		if (fcntl(fd, F_SETFL, O_NONBLOCK) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0)
+		{
+			close(fd);
+			continue;
+		}
+		Scrape *s = new Scrape();
+		s->deadline.fd = fd;
+		s->deadline.kind = TIMER_SCRAPE;
+		scrapes.insert(fd, s);
+		r.loop->add(fd, EventLoop::EV_READ);
+		r.timers.arm(s->deadline, monotonicNanos() + Scrape::TIMEOUT_NS);
+	}
+}
 
-	while (g_running)
+// One-shot HTTP/1.0: the request is read up to its blank line (and
+// otherwise ignored), then the metrics are rendered and written as far as
+// the socket allows; the rest goes out on the next EV_WRITE.
+void server::handle_scrape(Reactor &r, int fd)
+{
+	Scrape *s = *scrapes.find(fd);
+	char buf[1024];
+	while (!s->replying)
 	{
-		int num_fds = static_cast<int>(poll_fds.size());
-		int ready_fd = poll(&poll_fds[0], num_fds, -1);
-		if (ready_fd < 0) {
-			if (4 == EINTR) {
+		ssize_t n = recv(fd, buf, sizeof(buf), 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		if (n > 0)
+			s->data.append(buf, n);
+		if (n <= 0 || s->data.find("\r\n\r\n") != std::string::npos
+			|| s->data.size() >= Scrape::MAX_REQUEST)
+		{
+			std::string body;
+			lock_state(r);
+			renderMetrics(body, *client_manager, *channel_manager);
+			unlock_state();
+			std::ostringstream head;
+			head << "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+				<< "Content-Length: " << body.size() << "\r\nConnection: close\r\n\r\n";
+			s->data = head.str() + body;
+			s->replying = true;
+			r.loop->modify(fd, EventLoop::EV_WRITE);
+		}
+	}
+	while (s->sent < s->data.size())
+	{
+		ssize_t n = send(fd, s->data.data() + s->sent, s->data.size() - s->sent, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		if (n <= 0)
+			break;
+		s->sent += n;
+	}
+	close_scrape(r, fd);
+}
+
+void server::close_scrape(Reactor &r, int fd)
+{
+	Scrape **slot = scrapes.find(fd);
+	if (!slot)
+		return;
+	Scrape *s = *slot;
+	r.timers.cancel(s->deadline);
+	r.loop->remove(fd);
+	close(fd);
+	scrapes.erase(fd);
+	delete s;
+}
+
+void server::run_worker(Reactor &r)
+{
+	while (server_running())
+	{
+		int ready = r.loop->wait(r.events, loop_timeout(r));
+		if (ready < 0) {
+			if (errno == EINTR) {
 				// interrupted by signal; check running flag
-				if (!g_running) break;
+				if (!server_running()) break;
 				continue;
 			}
-			throw std::runtime_error("poll() failed");
+			throw std::runtime_error("event loop wait failed");
 		}
-		for(size_t i = 0; i < poll_fds.size(); ++i)
+		ServerStats& stats = serverStats();
+		unsigned long long woke = monotonicNanos();
+		stats.readyFds.record(r.events.size());
+		bool listener_ready = r.accept_pending;
+		run_timers(r);
+		if (!r.runnable.empty())
+			run_deferred_input(r);
+		for (size_t i = 0; i < r.events.size(); ++i)
 		{
-			if (poll_fds[i].revents & POLLIN)
-			{
-				if (poll_fds[i].fd == server_fd)
-				{
-					accept_new_client();
-
-				}
-				else
-				{
-					// Handle client data
-					char buffer[1024];
-					int bytes = recv(poll_fds[i].fd, buffer, sizeof(buffer) - 1, 0);
-					if (bytes <= 0)
-					{
-						if (errno == EWOULDBLOCK)
-							continue;
-						else if (bytes == 0)
-						{
-							Client* client = client_manager->getClientByFd(poll_fds[i].fd);
-							Channel* ch;
-							std::map<std::string, Channel*>& all = channel_manager->getAllChannels();
-							for (std::map<std::string, Channel*>::iterator it = all.begin(); it != all.end(); ++it) {
-								ch = it->second;
-								if (ch->isMember(poll_fds[i].fd)) {
-									ch->removeMember(poll_fds[i].fd, client_manager, true);
-									std::string quitMsg = ":" + (client->getNick().empty() ? std::string("*") : client->getNick()) + "!" + client->getUser() + "@" + client->getHost() + " QUIT\r\n";
-									ch->broadcast(quitMsg, client_manager, poll_fds[i].fd);
-								}
-							}
-							client_manager->removeClient(poll_fds[i].fd);
-							std::cout << "Client disconnected (fd=" << poll_fds[i].fd << ")" << std::endl;
-							std::cout << "Client quit (fd=" << poll_fds[i].fd << ")" << std::endl;
-							poll_fds.erase(poll_fds.begin() + i);
-							--i;
-						}
-					}
-					else
-					{
-						buffer[bytes] = '\0';
-						Client* client = client_manager->getClientByFd(poll_fds[i].fd);
-						if (client)
-						{
-							client->appendToRecv(std::string(buffer, bytes));
-							while (client->hasCompleteMessage())
-							{
-								std::string msg = client->popMessage();
-								client->handleClientMessage(msg, channel_manager, client_manager);
-								// If the client marked itself for quit, remove it and its pollfd here
-								if (client->shouldQuit()) {
-									Channel* ch;
-									std::map<std::string, Channel*>& all = channel_manager->getAllChannels();
-									for (std::map<std::string, Channel*>::iterator it = all.begin(); it != all.end(); ++it) {
-										ch = it->second;
-										if (ch->isMember(poll_fds[i].fd)) {
-											ch->removeMember(poll_fds[i].fd, client_manager, true);
-											std::string quitMsg = ":" + (client->getNick().empty() ? std::string("*") : client->getNick()) + "!" + client->getUser() + "@" + client->getHost() + " QUIT\r\n";
-											ch->broadcast(quitMsg, client_manager, poll_fds[i].fd);
-										}
-									}
-									client_manager->removeClient(poll_fds[i].fd);
-									std::cout << "Client quit (fd=" << poll_fds[i].fd << ")" << std::endl;
-									poll_fds.erase(poll_fds.begin() + i);
-									--i;
-									break; // stop processing this fd
-								}
-							}
-						}
-						else
-						{
-							std::cerr << "No client found for fd " << poll_fds[i].fd << std::endl;
-						}
-					}
-
-				}
-			}
-
+			if (r.events[i].fd == r.listen_fd)
+				listener_ready = true;
+			else if (r.events[i].fd == r.mailbox.wakeFd())
+				r.mailbox.clearWake();
+			else if (r.events[i].fd == metrics_fd)
+				serve_metrics();
+			else if (r.index == 0 && scrapes.contains(r.events[i].fd))
+				handle_scrape(r, r.events[i].fd);
+			else
+				handle_client_event(r, r.events[i]);
 		}
+		if (listener_ready)
+			accept_new_client(r);
+		if (!r.mailbox.empty()) {
+			lock_state(r);
+			run_deferred_work(r);
+			unlock_state();
+		}
+		stats.loopBusyNs.record(monotonicNanos() - woke);
 	}
+}
+
+void *server::worker_entry(void *arg)
+{
+	Reactor *r = static_cast<Reactor*>(arg);
+	try {
+		r->owner->run_worker(*r);
+	}
+	catch (const std::exception& e) {
+		IRC_LOG(Log::ERROR) << "Error: worker " << r->index << ": " << e.what();
+	}
+	// Take the whole server down with us; worker 0 is woken to notice
+	stop_server();
+	r->owner->reactors[0]->mailbox.wake();
+	return NULL;
+}
+
+// Workers 1..N-1 get their own threads; worker 0 runs here. Signals are
+// blocked in the extra threads so SIGINT/SIGTERM always interrupt the
+// main thread, which then wakes and joins the others.
+void server::run()
+{
+	IRC_LOG(Log::INFO) << "Server running on port " << port;
+
+	sigset_t stop, previous;
+	sigemptyset(&stop);
+	sigaddset(&stop, SIGINT);
+	sigaddset(&stop, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &stop, &previous);
+	for (size_t i = 1; i < reactors.size(); ++i)
+	{
+		if (pthread_create(&reactors[i]->thread, NULL, &server::worker_entry, reactors[i]) != 0)
+			throw std::runtime_error("Failed to start worker thread");
+	}
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+	try {
+		run_worker(*reactors[0]);
+	}
+	catch (...) {
+		stop_server();
+		for (size_t i = 1; i < reactors.size(); ++i)
+			reactors[i]->mailbox.wake();
+		for (size_t i = 1; i < reactors.size(); ++i)
+			pthread_join(reactors[i]->thread, NULL);
+		throw;
+	}
+	stop_server();
+	for (size_t i = 1; i < reactors.size(); ++i)
+		reactors[i]->mailbox.wake();
+	for (size_t i = 1; i < reactors.size(); ++i)
+		pthread_join(reactors[i]->thread, NULL);
 
 	// Graceful shutdown: notify clients and remove them
-	std::cout << "Shutting down server..." << std::endl;
+	IRC_LOG(Log::INFO) << "Shutting down server...";
+	const ServerStats& stats = serverStats();
+	IRC_LOG(Log::INFO) << "Output: " << stats.messagesOut << " messages, " << stats.bytesOut
+		<< " bytes in " << stats.writeCalls << " writev calls ("
+		<< stats.syscallsPerMessage() << " syscalls/message)";
+	IRC_LOG(Log::INFO) << "Accept: " << stats.acceptsTotal << " connections in "
+		<< stats.acceptWakeups << " wakeups (" << stats.acceptsPerWakeup()
+		<< " per wakeup, max " << stats.maxAcceptsPerWakeup << ")";
+	const PoolStats& cp = Client::poolStats();
+	const PoolStats& hp = Channel::poolStats();
+	IRC_LOG(Log::INFO) << "Pools: clients " << cp.live << " live, " << cp.peak << " peak, "
+		<< cp.capacity << " slots; channels " << hp.live << " live, " << hp.peak
+		<< " peak, " << hp.capacity << " slots";
+	shutdown_clients();
+}
+
+// Only the main thread is left at this point.
+void server::shutdown_clients()
+{
 	if (client_manager) {
-		std::vector<int> fds;
-		std::map<int, Client*>& all = client_manager->getAllClients();
-		for (std::map<int, Client*>::iterator it = all.begin(); it != all.end(); ++it) {
-			fds.push_back(it->first);
-		}
-		for (size_t i = 0; i < fds.size(); ++i) {
-			Client* c = client_manager->getClientByFd(fds[i]);
-			if (c) {
-				std::string notice = ":localhost NOTICE " + (c->getNick().empty() ? std::string("*") : c->getNick()) + " :Server is shutting down\r\n";
-				send(c->getFd(), notice.c_str(), notice.size(), 0);
-			}
-			client_manager->removeClient(fds[i]);
+		// Walk the dense table from the back: removal swaps the last entry
+		// into the freed position.
+		FdTable<Client*>& all = client_manager->getAllClients();
+		while (!all.empty()) {
+			Client* c = all.valueAt(all.size() - 1);
+			std::string notice = ":localhost NOTICE " + (c->getNick().empty() ? std::string("*") : c->getNick()) + " :Server is shutting down\r\n";
+			c->queueSend(notice);
+			c->flushSend();
+			Reactor *r = reactors[c->getOwner()];
+			r->timers.cancel(c->livenessTimer());
+			r->timers.cancel(c->floodTimer());
+			r->loop->remove(c->getFd());
+			r->clients.erase(c->getFd());
+			client_manager->removeClient(all.fdAt(all.size() - 1));
 		}
 	}
-	// Close listening socket
-	if (server_fd != -1) {
-		close(server_fd);
-		server_fd = -1;
+	// Close listening sockets
+	while (!scrapes.empty())
+		close_scrape(*reactors[0], scrapes.fdAt(scrapes.size() - 1));
+	if (metrics_fd != -1) {
+		close(metrics_fd);
+		metrics_fd = -1;
+	}
+	for (size_t i = 0; i < reactors.size(); ++i) {
+		if (reactors[i]->listen_fd != -1) {
+			close(reactors[i]->listen_fd);
+			reactors[i]->listen_fd = -1;
+		}
 	}
-	poll_fds.clear();
 }
 server::~server()
 {
-	for (size_t i = 0; i < poll_fds.size(); ++i)
-	{
-		if (poll_fds[i].fd != server_fd && poll_fds[i].fd != -1)// again
-			close(poll_fds[i].fd);//again
-	}
-	if (server_fd != -1)
-	{
-		close(server_fd);
-	}
 	delete client_manager;
 	delete channel_manager;
+	if (metrics_fd != -1)
+		close(metrics_fd);
+	for (size_t i = 0; i < reactors.size(); ++i)
+	{
+		if (reactors[i]->listen_fd != -1)
+			close(reactors[i]->listen_fd);
+		delete reactors[i]->loop;
+		delete reactors[i];
+	}
+	pthread_mutex_destroy(&state_lock);
 }
@@ -6,7 +6,6 @@
 #include <iostream>
 #include <fcntl.h>
 #include <unistd.h>
-#include <poll.h>
 #include <vector>
 #include <cstring>
 #include <cerrno>
@@ -18,30 +17,129 @@
 #include <map>
 #include "ClientManager.hpp"
 #include "ChannelManager.hpp"
+#include "EventLoop.hpp"
+#include "FdTable.hpp"
+#include "Mailbox.hpp"
+#include "TimerWheel.hpp"
+#include "Histogram.hpp"
+#include "parser.hpp"
+#include <pthread.h>
+
+class server;
+
+// Meaning of a Client's timers (Timer::kind)
+enum TimerKind {
+	TIMER_REGISTRATION,		// PASS/NICK/USER deadline
+	TIMER_KEEPALIVE,		// idle check, sends PING when due
+	TIMER_PING_TIMEOUT,		// PING sent, waiting for any reply
+	TIMER_FLOOD,			// flood tokens for held input are back
+	TIMER_SCRAPE			// metrics exchange ran out of time
+};
+
+// One connection to the metrics endpoint: the request is read into data,
+// which is then replaced by the response and written out. Whole exchange
+// is bounded by one deadline on worker 0's timer wheel.
+struct Scrape {
+	static const size_t MAX_REQUEST = 8192;
+	static const unsigned long long TIMEOUT_NS = 2000000000ULL;	// 2 s
+
+	std::string data;
+	size_t sent;
+	bool replying;
+	Timer deadline;
+
+	Scrape() : sent(0), replying(false) {}
+};
+
+// One worker thread: its own SO_REUSEPORT listener, event loop and set of
+// connections. Worker 0 runs on the main thread. Shared IRC state (clients,
+// channels) is only touched while holding the server's state lock; the
+// socket I/O and the clients table below belong to the worker alone.
+struct Reactor {
+	int index;
+	server *owner;
+	pthread_t thread;
+	int listen_fd;
+	EventLoop *loop;
+	std::vector<IoEvent> events;
+	bool accept_pending;		// batch limit hit with connections left queued
+	FdTable<Client*> clients;	// connections served by this worker
+	Mailbox mailbox;			// flush / removal requests from any worker
+	TimerWheel timers;			// this worker's clients' timers
+	std::vector<Timer*> expired;
+	FdTable<char> held;			// connections with input left to run
+	std::vector<int> runnable;	// held by the line budget: run next iteration
+	std::vector<Client::InputLine> input;	// lines taken outside the lock, run under it
+	std::vector<Client*> flushing;	// output taken, written outside the lock
+	std::vector<Client::FlushResult> flushResults;
+
+	Reactor() : index(0), owner(NULL), listen_fd(-1), loop(NULL), accept_pending(false),
+		timers(monotonicNanos()) {}
+};
 
 class server{
 	private:
-	int server_fd;
 	int port;
 	std::string password;
+	std::string backend;
+	size_t sendq;
+	size_t recvq;
+	size_t line_max;
+	int listen_backlog;
+	size_t accept_batch;
+	int thread_count;
+	int metrics_port;
+	unsigned line_budget;
+	unsigned register_timeout;
+	unsigned ping_interval;
+	unsigned ping_timeout;
+	unsigned flood_rate;
+	unsigned flood_burst;
+	int metrics_fd;			// loopback admin listener, served by worker 0
+	FdTable<Scrape*> scrapes;	// open metrics connections, worker 0 only
+
+	std::vector<Reactor*> reactors;
+	pthread_mutex_t state_lock;	// serializes access to the shared IRC state
 
-	std::vector<pollfd> poll_fds;
-	void accept_new_client();
+	void accept_new_client(Reactor &r);
+	void handle_client_event(Reactor &r, const IoEvent &ev);
+	void read_from_client(Reactor &r, int fd);
+	void read_input(Reactor &r, Client *client);
+	void watch_input(Reactor &r, Client *client);
+	void run_deferred_input(Reactor &r);
+	void run_timers(Reactor &r);
+	void start_timers(Reactor &r, Client *client);
+	void start_keepalive(Reactor &r, Client *client);
+	void check_liveness(Reactor &r, Client *client, Timer &t);
+	int loop_timeout(Reactor &r);
+	void remove_client(Reactor &r, int fd);
+	void flush_client(Reactor &r, Client *client);
+	void write_flushing(Reactor &r);
+	void run_deferred_work(Reactor &r);
+	void run_worker(Reactor &r);
+	void lock_state(Reactor &r);
+	void unlock_state();
+	void shutdown_clients();
+	void setup_metrics();
+	void serve_metrics();
+	void handle_scrape(Reactor &r, int fd);
+	void close_scrape(Reactor &r, int fd);
+	static void *worker_entry(void *arg);
 
 	ClientManager *client_manager;
 	ChannelManager *channel_manager;
 
 	public:
-	server(int port, const std::string& password);
+	server(const ServerConfig& config);
 	server(const server& other);
 	server& operator=(const server& other);
 
 	int create_socket();
 
-	void set_socket_options();
-	void bind_socket();
-	void listen_socket();
-	void setup_poll();
+	void set_socket_options(int fd);
+	void bind_socket(int fd);
+	void listen_socket(int fd);
+	void setup_event_loop(Reactor &r);
 	void	setup();
 	void run();
 
@@ -0,0 +1,30 @@
+#include "Stats.hpp"
+
+ServerStats::ServerStats()
+    : startedAt(time(NULL)), writeCalls(0), messagesOut(0), bytesOut(0),
+      messagesIn(0), bytesIn(0), unknownCommands(0), floodThrottled(0), timedOut(0),
+      acceptWakeups(0), acceptsTotal(0), maxAcceptsPerWakeup(0) {}
+
+double ServerStats::syscallsPerMessage() const {
+    if (messagesOut == 0)
+        return 0.0;
+    return static_cast<double>(writeCalls) / static_cast<double>(messagesOut);
+}
+
+void ServerStats::recordAcceptWakeup(unsigned long long accepted) {
+    ++acceptWakeups;
+    acceptsTotal += accepted;
+    if (accepted > maxAcceptsPerWakeup)
+        maxAcceptsPerWakeup = accepted;
+}
+
+double ServerStats::acceptsPerWakeup() const {
+    if (acceptWakeups == 0)
+        return 0.0;
+    return static_cast<double>(acceptsTotal) / static_cast<double>(acceptWakeups);
+}
+
+ServerStats& serverStats() {
+    static ServerStats stats;
+    return stats;
+}
@@ -0,0 +1,42 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <ctime>
+#include "Histogram.hpp"
+
+// Process-wide counters updated on the hot paths. The plain integers are
+// only touched with the server state lock held; the histograms are
+// thread-safe on their own. Exported by renderMetrics() (Metrics.hpp) and
+// the IRC STATS command.
+struct ServerStats {
+    static const int MAX_COMMANDS = 16;     // >= entries in CommandTable
+
+    time_t              startedAt;
+    unsigned long long  writeCalls;     // writev() syscalls on client sockets
+    unsigned long long  messagesOut;    // queued lines fully written
+    unsigned long long  bytesOut;
+    unsigned long long  messagesIn;     // non-empty lines received
+    unsigned long long  bytesIn;
+    unsigned long long  unknownCommands;
+    unsigned long long  floodThrottled;     // times a client's input was held back
+    unsigned long long  timedOut;           // registration and ping timeouts
+    unsigned long long  acceptWakeups;      // listener readiness handled
+    unsigned long long  acceptsTotal;       // connections accepted
+    unsigned long long  maxAcceptsPerWakeup;
+
+    Histogram           loopBusyNs;     // event loop iteration, wakeup to idle
+    Histogram           readyFds;       // events returned per wakeup
+    Histogram           commandNs[MAX_COMMANDS];    // by CommandTable index
+
+    ServerStats();
+
+    // Average number of write syscalls needed per delivered line.
+    double syscallsPerMessage() const;
+
+    void recordAcceptWakeup(unsigned long long accepted);
+    double acceptsPerWakeup() const;
+};
+
+ServerStats& serverStats();
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef STRING_VIEW_HPP
+#define STRING_VIEW_HPP
+
+#include <string>
+#include <cstring>
+#include <cstddef>
+
+// Non-owning view over a run of characters (C++98 has no std::string_view).
+// Views into a client's receive buffer stay valid until the next read.
+class StringView {
+private:
+    const char* _data;
+    size_t      _size;
+
+public:
+    StringView() : _data(""), _size(0) {}
+    StringView(const char* data, size_t size) : _data(data), _size(size) {}
+    StringView(const char* cstr) : _data(cstr), _size(std::strlen(cstr)) {}
+    StringView(const std::string& s) : _data(s.data()), _size(s.size()) {}
+
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    char operator[](size_t i) const { return _data[i]; }
+
+    std::string str() const { return std::string(_data, _size); }
+
+    StringView substr(size_t pos, size_t len = std::string::npos) const {
+        if (pos > _size) pos = _size;
+        if (len > _size - pos) len = _size - pos;
+        return StringView(_data + pos, len);
+    }
+
+    bool operator==(const StringView& o) const {
+        return _size == o._size && std::memcmp(_data, o._data, _size) == 0;
+    }
+    bool operator!=(const StringView& o) const { return !(*this == o); }
+};
+
+#endif
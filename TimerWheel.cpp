@@ -0,0 +1,139 @@
+#include "TimerWheel.hpp"
+
+TimerWheel::TimerWheel(unsigned long long nowNs)
+    : _now(nowNs / TICK_NS), _count(0) {
+    for (int l = 0; l < LEVELS; ++l) {
+        _occupied[l] = 0;
+        for (int s = 0; s < SLOTS; ++s)
+            _slots[l][s] = NULL;
+    }
+}
+
+// Level l holds timers due within SLOTS^(l+1) ticks, in the slot of their
+// expiry's l-th digit. Timers beyond the top level are parked in its
+// furthest slot and re-filed when it comes round.
+void TimerWheel::link(Timer& t) {
+    unsigned long long delta = t.expires > _now ? t.expires - _now : 0;
+    unsigned long long at = t.expires;
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (1ULL << (SLOT_BITS * (level + 1))))
+        ++level;
+    unsigned long long span = 1ULL << (SLOT_BITS * LEVELS);
+    if (delta >= span)
+        at = _now + span - 1;
+    int slot = static_cast<int>((at >> (SLOT_BITS * level)) & (SLOTS - 1));
+    t.level = static_cast<unsigned char>(level);
+    t.slot = static_cast<unsigned char>(slot);
+    t.prev = NULL;
+    t.next = _slots[level][slot];
+    if (t.next)
+        t.next->prev = &t;
+    _slots[level][slot] = &t;
+    _occupied[level] |= 1ULL << slot;
+    t.armed = true;
+    ++_count;
+}
+
+void TimerWheel::unlink(Timer& t) {
+    if (t.prev)
+        t.prev->next = t.next;
+    else
+        _slots[t.level][t.slot] = t.next;
+    if (t.next)
+        t.next->prev = t.prev;
+    if (!_slots[t.level][t.slot])
+        _occupied[t.level] &= ~(1ULL << t.slot);
+    t.prev = NULL;
+    t.next = NULL;
+    t.armed = false;
+    --_count;
+}
+
+void TimerWheel::arm(Timer& t, unsigned long long atNs) {
+    if (t.armed)
+        unlink(t);
+    unsigned long long tick = (atNs + TICK_NS - 1) / TICK_NS;
+    t.expires = tick > _now ? tick : _now + 1;
+    link(t);
+}
+
+void TimerWheel::cancel(Timer& t) {
+    if (t.armed)
+        unlink(t);
+}
+
+// Re-files the timers of the level's current slot one level down (or
+// further, once they are close enough).
+void TimerWheel::cascade(int level) {
+    int slot = static_cast<int>((_now >> (SLOT_BITS * level)) & (SLOTS - 1));
+    Timer* t = _slots[level][slot];
+    _slots[level][slot] = NULL;
+    _occupied[level] &= ~(1ULL << slot);
+    while (t) {
+        Timer* next = t->next;
+        --_count;
+        link(*t);
+        t = next;
+    }
+}
+
+void TimerWheel::advance(unsigned long long nowNs, std::vector<Timer*>& expired) {
+    unsigned long long target = nowNs / TICK_NS;
+    if (_count == 0) {
+        if (target > _now)
+            _now = target;
+        return;
+    }
+    while (_now < target) {
+        ++_now;
+        // Entering a new revolution of level l brings its next slot down.
+        for (int l = 1; l < LEVELS; ++l) {
+            if (_now & ((1ULL << (SLOT_BITS * l)) - 1))
+                break;
+            cascade(l);
+        }
+        int slot = static_cast<int>(_now & (SLOTS - 1));
+        while (Timer* t = _slots[0][slot]) {
+            unlink(*t);
+            expired.push_back(t);
+        }
+        if (_count == 0) {
+            _now = target;
+            break;
+        }
+    }
+}
+
+// Bits of `mask` at or after `from`, rotated so that `from` is bit 0.
+static int nextSetBit(unsigned long long mask, int from) {
+    unsigned long long rotated = from ? (mask >> from) | (mask << (64 - from)) : mask;
+    return rotated ? __builtin_ctzll(rotated) : -1;
+}
+
+unsigned long long TimerWheel::ticksToNext() const {
+    unsigned long long best = ~0ULL;
+    for (int l = 0; l < LEVELS; ++l) {
+        if (!_occupied[l])
+            continue;
+        int shift = SLOT_BITS * l;
+        int current = static_cast<int>((_now >> shift) & (SLOTS - 1));
+        // Level 0: the slot fires; above: the slot cascades at the start
+        // of its range. A level's current slot was handled already.
+        int d = nextSetBit(_occupied[l], (current + 1) & (SLOTS - 1));
+        unsigned long long block = (_now >> shift) + 1 + static_cast<unsigned long long>(d);
+        unsigned long long ticks = (block << shift) - _now;
+        if (ticks < best)
+            best = ticks;
+    }
+    return best;
+}
+
+int TimerWheel::timeoutMs(unsigned long long nowNs) const {
+    if (_count == 0)
+        return -1;
+    unsigned long long due = (_now + ticksToNext()) * TICK_NS;
+    if (due <= nowNs)
+        return 0;
+    unsigned long long ms = (due - nowNs + 999999) / 1000000;
+    return ms > 0x7fffffffULL ? 0x7fffffff : static_cast<int>(ms);
+}
@@ -0,0 +1,68 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Intrusive timer: lives inside the object it belongs to (e.g. a Client)
+// and is linked into a TimerWheel slot while armed. What a timer means is
+// up to the owner; the wheel only hands expired timers back.
+struct Timer {
+    Timer*              prev;
+    Timer*              next;
+    unsigned long long  expires;    // tick
+    unsigned char       level;      // slot position while armed
+    unsigned char       slot;
+    bool                armed;
+    int                 fd;         // owner's connection
+    int                 kind;       // owner-defined meaning
+
+    Timer() : prev(NULL), next(NULL), expires(0), level(0), slot(0),
+              armed(false), fd(-1), kind(0) {}
+};
+
+// Hierarchical timer wheel: LEVELS wheels of SLOTS slots each, level l
+// covering SLOTS^(l+1) ticks. arm() and cancel() are O(1); a timer is
+// moved down one level at a time as its slot comes round (at most
+// LEVELS - 1 moves), and a 64-bit occupancy mask per level finds the next
+// pending slot without scanning. Not thread-safe: one wheel per worker.
+class TimerWheel {
+public:
+    static const int SLOT_BITS = 6;
+    static const int SLOTS = 1 << SLOT_BITS;
+    static const int LEVELS = 4;
+    static const unsigned long long TICK_NS = 10000000ULL;  // 10 ms
+
+    explicit TimerWheel(unsigned long long nowNs);
+
+    // (Re)arms t to fire at or after atNs, never earlier than the next tick.
+    void arm(Timer& t, unsigned long long atNs);
+    void cancel(Timer& t);
+
+    // Moves the wheel to nowNs and appends every timer that expired on
+    // the way to `expired`; they are disarmed before being returned.
+    void advance(unsigned long long nowNs, std::vector<Timer*>& expired);
+
+    // Milliseconds until the wheel next needs advance(), for the event
+    // loop timeout: -1 when no timer is armed. May wake early (when a
+    // higher level needs cascading), never late.
+    int timeoutMs(unsigned long long nowNs) const;
+
+    size_t size() const { return _count; }
+
+private:
+    Timer*              _slots[LEVELS][SLOTS];
+    unsigned long long  _occupied[LEVELS];  // bit per non-empty slot
+    unsigned long long  _now;               // current tick
+    size_t              _count;
+
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+
+    void link(Timer& t);
+    void unlink(Timer& t);
+    void cascade(int level);
+    unsigned long long ticksToNext() const;
+};
+
+#endif
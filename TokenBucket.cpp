@@ -0,0 +1,33 @@
+#include "TokenBucket.hpp"
+
+TokenBucket::TokenBucket() : _interval(0), _capacity(0), _full(0) {}
+
+void TokenBucket::configure(unsigned rate, unsigned burst) {
+    _interval = rate ? 1000000000ULL / rate : 0;
+    _capacity = _interval * (burst ? burst : 1);
+    _full = 0;
+}
+
+unsigned long long TokenBucket::charge(unsigned cost) const {
+    unsigned long long ns = _interval * cost;
+    return ns > _capacity ? _capacity : ns;
+}
+
+bool TokenBucket::take(unsigned cost, unsigned long long nowNs) {
+    if (_interval == 0)
+        return true;
+    unsigned long long base = _full > nowNs ? _full : nowNs;
+    unsigned long long next = base + charge(cost);
+    if (next - nowNs > _capacity)
+        return false;
+    _full = next;
+    return true;
+}
+
+unsigned long long TokenBucket::readyAt(unsigned cost, unsigned long long nowNs) const {
+    if (_interval == 0)
+        return nowNs;
+    unsigned long long base = _full > nowNs ? _full : nowNs;
+    unsigned long long ready = base + charge(cost) - _capacity;
+    return ready > nowNs ? ready : nowNs;
+}
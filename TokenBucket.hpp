@@ -0,0 +1,30 @@
+#ifndef TOKEN_BUCKET_HPP
+#define TOKEN_BUCKET_HPP
+
+// Flood control for one client: holds up to `burst` tokens and refills at
+// `rate` tokens per second. Stored as the time at which the bucket will be
+// full again (the GCRA form of a token bucket), so there is no refill step:
+// each take() is a max, an add and a compare.
+class TokenBucket {
+public:
+    TokenBucket();
+
+    // rate 0 disables the limit.
+    void configure(unsigned rate, unsigned burst);
+
+    // Charges cost tokens if the bucket holds them. A cost above the burst
+    // is charged as the whole burst, so every command stays possible.
+    bool take(unsigned cost, unsigned long long nowNs);
+
+    // Earliest time at which take(cost) succeeds.
+    unsigned long long readyAt(unsigned cost, unsigned long long nowNs) const;
+
+private:
+    unsigned long long  _interval;  // ns per token, 0 = unlimited
+    unsigned long long  _capacity;  // burst * interval
+    unsigned long long  _full;      // when the bucket is full again
+
+    unsigned long long charge(unsigned cost) const;
+};
+
+#endif
@@ -0,0 +1,561 @@
+// Load generator for ircserv: N simulated clients over loopback, driven
+// from one epoll loop so the generator itself stays cheap next to the
+// server. Every PRIVMSG carries its send time; receivers turn that into an
+// end-to-end delivery latency. One CSV row is appended per run.
+//
+//   loadgen --port 6790 --password pw --clients 200 --channels 20
+//           --dist zipf --rate 20000 --duration 10 --csv bench/results.csv
+
+#include "Histogram.hpp"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string host;
+    int port;
+    std::string password;
+    int clients;
+    int channels;
+    int joins;              // channels joined by each client at start
+    std::string dist;       // "uniform" or "zipf"
+    double rate;            // operations per second, all clients together
+    double duration;        // measured seconds
+    double warmup;          // unmeasured seconds before that
+    int mix[4];             // PRIVMSG, JOIN, PART, NICK weights
+    std::string csv;
+    std::string label;
+    int serverPid;          // for the RSS column, 0 = unknown
+
+    Options() : host("127.0.0.1"), port(6667), password("pw"), clients(100),
+                channels(10), joins(1), dist("uniform"), rate(10000),
+                duration(10), warmup(1), serverPid(0) {
+        mix[0] = 90; mix[1] = 4; mix[2] = 4; mix[3] = 2;
+    }
+};
+
+enum Op { OP_PRIVMSG, OP_JOIN, OP_PART, OP_NICK };
+
+struct Conn {
+    int fd;
+    int id;
+    int generation;                 // bumped by every NICK change
+    bool registered;
+    bool dead;
+    std::string in;
+    std::string out;
+    size_t outOff;
+    bool wantWrite;
+    std::vector<int> joined;        // channel indexes
+
+    Conn() : fd(-1), id(0), generation(0), registered(false), dead(false),
+             outOff(0), wantWrite(false) {}
+};
+
+struct Totals {
+    unsigned long long sent;        // PRIVMSG lines sent while measuring
+    unsigned long long delivered;   // PRIVMSG lines received while measuring
+    unsigned long long ops;
+    unsigned long long errors;      // numerics >= 400 and dropped connections
+
+    Totals() : sent(0), delivered(0), ops(0), errors(0) {}
+};
+
+// xorshift64*: deterministic across runs, so two commits see the same load.
+unsigned long long g_rng = 0x9E3779B97F4A7C15ULL;
+
+unsigned long long nextRandom() {
+    g_rng ^= g_rng >> 12;
+    g_rng ^= g_rng << 25;
+    g_rng ^= g_rng >> 27;
+    return g_rng * 2685821657736338717ULL;
+}
+
+double uniformRandom() {
+    return static_cast<double>(nextRandom() >> 11) / 9007199254740992.0;
+}
+
+// Channel picker: uniform, or Zipf (s = 1) so a few channels are huge and
+// most are small, the usual shape of a real network.
+class ChannelPicker {
+public:
+    ChannelPicker(int count, const std::string& dist) : _cdf(count) {
+        double total = 0;
+        for (int i = 0; i < count; ++i) {
+            total += dist == "zipf" ? 1.0 / (i + 1) : 1.0;
+            _cdf[i] = total;
+        }
+        for (int i = 0; i < count; ++i)
+            _cdf[i] /= total;
+    }
+
+    int pick() const {
+        double u = uniformRandom();
+        size_t lo = 0, hi = _cdf.size() - 1;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (_cdf[mid] < u)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return static_cast<int>(lo);
+    }
+
+private:
+    std::vector<double> _cdf;
+};
+
+double toSeconds(unsigned long long ns) {
+    return static_cast<double>(ns) / 1e9;
+}
+
+std::string channelName(int index) {
+    std::ostringstream name;
+    name << "#bench" << index;
+    return name.str();
+}
+
+std::string nickName(const Conn& c) {
+    std::ostringstream nick;
+    nick << "c" << c.id << "g" << c.generation;
+    return nick.str();
+}
+
+void usage() {
+    std::cerr << "usage: loadgen [--host H] [--port P] [--password PW] [--clients N]\n"
+                 "               [--channels M] [--joins K] [--dist uniform|zipf]\n"
+                 "               [--rate OPS] [--duration S] [--warmup S]\n"
+                 "               [--mix PRIVMSG,JOIN,PART,NICK] [--csv FILE]\n"
+                 "               [--label TEXT] [--server-pid PID]\n";
+}
+
+Options parseOptions(int ac, char** av) {
+    Options o;
+    for (int i = 1; i < ac; ++i) {
+        std::string key = av[i];
+        if (i + 1 >= ac)
+            throw std::runtime_error("missing value for " + key);
+        std::string value = av[++i];
+        if (key == "--host") o.host = value;
+        else if (key == "--port") o.port = std::atoi(value.c_str());
+        else if (key == "--password") o.password = value;
+        else if (key == "--clients") o.clients = std::atoi(value.c_str());
+        else if (key == "--channels") o.channels = std::atoi(value.c_str());
+        else if (key == "--joins") o.joins = std::atoi(value.c_str());
+        else if (key == "--dist") o.dist = value;
+        else if (key == "--rate") o.rate = std::atof(value.c_str());
+        else if (key == "--duration") o.duration = std::atof(value.c_str());
+        else if (key == "--warmup") o.warmup = std::atof(value.c_str());
+        else if (key == "--csv") o.csv = value;
+        else if (key == "--label") o.label = value;
+        else if (key == "--server-pid") o.serverPid = std::atoi(value.c_str());
+        else if (key == "--mix") {
+            if (std::sscanf(value.c_str(), "%d,%d,%d,%d", &o.mix[0], &o.mix[1], &o.mix[2], &o.mix[3]) != 4)
+                throw std::runtime_error("--mix takes four comma separated weights");
+        } else
+            throw std::runtime_error("unknown option " + key);
+    }
+    if (o.clients < 2 || o.channels < 1 || o.joins < 1 || o.joins > o.channels)
+        throw std::runtime_error("need --clients >= 2 and 1 <= --joins <= --channels");
+    if (o.dist != "uniform" && o.dist != "zipf")
+        throw std::runtime_error("--dist must be uniform or zipf");
+    if (o.rate <= 0 || o.duration <= 0 || o.warmup < 0)
+        throw std::runtime_error("--rate and --duration must be positive");
+    if (o.mix[0] + o.mix[1] + o.mix[2] + o.mix[3] <= 0 || o.mix[0] <= 0)
+        throw std::runtime_error("--mix needs a positive PRIVMSG weight");
+    return o;
+}
+
+// Peak resident set size of the server (VmHWM, tracked by the kernel over
+// the process lifetime) from /proc, in kB; 0 when unknown.
+long readPeakRssKb(int pid) {
+    if (pid <= 0)
+        return 0;
+    std::ostringstream path;
+    path << "/proc/" << pid << "/status";
+    std::ifstream status(path.str().c_str());
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return std::atol(line.c_str() + 6);
+    }
+    return 0;
+}
+
+class LoadGenerator {
+public:
+    explicit LoadGenerator(const Options& o)
+        : _o(o), _picker(o.channels, o.dist), _epfd(-1), _measuring(false), _peakRss(0),
+          _measuredNs(0) {
+        _epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (_epfd < 0)
+            throw std::runtime_error("epoll_create1 failed");
+        _conns.resize(o.clients);
+    }
+
+    ~LoadGenerator() {
+        for (size_t i = 0; i < _conns.size(); ++i) {
+            if (_conns[i].fd >= 0)
+                close(_conns[i].fd);
+        }
+        if (_epfd >= 0)
+            close(_epfd);
+    }
+
+    void connectAll();
+    void waitRegistered();
+    void joinInitial();
+    void drive();
+    void report();
+
+private:
+    const Options& _o;
+    ChannelPicker _picker;
+    int _epfd;
+    std::vector<Conn> _conns;
+    bool _measuring;
+    Totals _totals;
+    Histogram _latency;
+    long _peakRss;
+    unsigned long long _measuredNs;
+
+    void send(Conn& c, const std::string& line);
+    void flush(Conn& c);
+    void updateInterest(Conn& c);
+    void poll(int timeoutMs);
+    void readFrom(Conn& c);
+    void handleLine(Conn& c, const std::string& line);
+    void drop(Conn& c);
+    void issue(Conn& c);
+    bool isMember(const Conn& c, int channel) const;
+};
+
+void LoadGenerator::connectAll() {
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(_o.port);
+    if (inet_pton(AF_INET, _o.host.c_str(), &addr.sin_addr) != 1)
+        throw std::runtime_error("bad --host address");
+    for (int i = 0; i < _o.clients; ++i) {
+        Conn& c = _conns[i];
+        c.id = i;
+        c.fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (c.fd < 0)
+            throw std::runtime_error("socket failed (raise ulimit -n?)");
+        if (::connect(c.fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+            throw std::runtime_error(std::string("connect failed: ") + std::strerror(errno));
+        int one = 1;
+        setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(c.fd, F_SETFL, O_NONBLOCK);
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = static_cast<unsigned>(i);
+        epoll_ctl(_epfd, EPOLL_CTL_ADD, c.fd, &ev);
+        // ircserv wants usernames to be unique as well.
+        send(c, "PASS " + _o.password + "\r\nNICK " + nickName(c) + "\r\nUSER u" + nickName(c)
+                + " 0 * :load generator\r\n");
+        // Keep the server's listen backlog from overflowing on big runs.
+        if (i % 64 == 63)
+            poll(0);
+    }
+}
+
+void LoadGenerator::waitRegistered() {
+    unsigned long long deadline = monotonicNanos() + 10000000000ULL;
+    while (monotonicNanos() < deadline) {
+        int done = 0;
+        for (size_t i = 0; i < _conns.size(); ++i)
+            done += _conns[i].registered || _conns[i].dead;
+        if (done == _o.clients)
+            return;
+        poll(10);
+    }
+    throw std::runtime_error("clients did not register within 10s");
+}
+
+void LoadGenerator::joinInitial() {
+    // Client i starts in channels i, i+1, ... for uniform sizes, or in
+    // picks from the Zipf distribution.
+    for (size_t i = 0; i < _conns.size(); ++i) {
+        Conn& c = _conns[i];
+        for (int j = 0; j < _o.joins && !c.dead; ++j) {
+            int channel = _o.dist == "zipf" ? _picker.pick() : static_cast<int>((i + j) % _o.channels);
+            if (isMember(c, channel))
+                continue;
+            c.joined.push_back(channel);
+            send(c, "JOIN " + channelName(channel) + "\r\n");
+        }
+    }
+    unsigned long long settle = monotonicNanos() + 500000000ULL;
+    while (monotonicNanos() < settle)
+        poll(10);
+}
+
+bool LoadGenerator::isMember(const Conn& c, int channel) const {
+    for (size_t i = 0; i < c.joined.size(); ++i) {
+        if (c.joined[i] == channel)
+            return true;
+    }
+    return false;
+}
+
+// One operation from the mix. PART never leaves a client without a channel
+// and JOIN falls back to PRIVMSG when the client is everywhere already.
+void LoadGenerator::issue(Conn& c) {
+    int total = _o.mix[0] + _o.mix[1] + _o.mix[2] + _o.mix[3];
+    int roll = static_cast<int>(nextRandom() % static_cast<unsigned long long>(total));
+    Op op = OP_PRIVMSG;
+    for (int i = 0, acc = 0; i < 4; ++i) {
+        acc += _o.mix[i];
+        if (roll < acc) {
+            op = static_cast<Op>(i);
+            break;
+        }
+    }
+    if (op == OP_PART && c.joined.size() < 2)
+        op = OP_JOIN;
+    if (op == OP_JOIN) {
+        int channel = _picker.pick();
+        if (isMember(c, channel))
+            op = OP_PRIVMSG;
+        else {
+            c.joined.push_back(channel);
+            send(c, "JOIN " + channelName(channel) + "\r\n");
+        }
+    }
+    if (op == OP_PART) {
+        size_t at = nextRandom() % c.joined.size();
+        send(c, "PART " + channelName(c.joined[at]) + " :bench\r\n");
+        c.joined[at] = c.joined.back();
+        c.joined.pop_back();
+    } else if (op == OP_NICK) {
+        ++c.generation;
+        send(c, "NICK " + nickName(c) + "\r\n");
+    } else if (op == OP_PRIVMSG) {
+        if (c.joined.empty())
+            return;
+        char line[96];
+        int channel = c.joined[nextRandom() % c.joined.size()];
+        std::snprintf(line, sizeof(line), "PRIVMSG #bench%d :b %llu\r\n", channel, monotonicNanos());
+        send(c, line);
+        if (_measuring)
+            ++_totals.sent;
+    }
+    if (_measuring)
+        ++_totals.ops;
+}
+
+void LoadGenerator::send(Conn& c, const std::string& line) {
+    if (c.dead)
+        return;
+    c.out += line;
+    flush(c);
+}
+
+void LoadGenerator::flush(Conn& c) {
+    while (c.outOff < c.out.size()) {
+        ssize_t n = ::send(c.fd, c.out.data() + c.outOff, c.out.size() - c.outOff, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            drop(c);
+            return;
+        }
+        c.outOff += static_cast<size_t>(n);
+    }
+    if (c.outOff == c.out.size()) {
+        c.out.clear();
+        c.outOff = 0;
+    }
+    updateInterest(c);
+}
+
+void LoadGenerator::updateInterest(Conn& c) {
+    bool want = !c.out.empty();
+    if (want == c.wantWrite)
+        return;
+    c.wantWrite = want;
+    struct epoll_event ev;
+    ev.events = want ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    ev.data.u32 = static_cast<unsigned>(c.id);
+    epoll_ctl(_epfd, EPOLL_CTL_MOD, c.fd, &ev);
+}
+
+void LoadGenerator::drop(Conn& c) {
+    if (c.dead)
+        return;
+    c.dead = true;
+    ++_totals.errors;
+    epoll_ctl(_epfd, EPOLL_CTL_DEL, c.fd, NULL);
+    close(c.fd);
+    c.fd = -1;
+}
+
+void LoadGenerator::poll(int timeoutMs) {
+    struct epoll_event events[256];
+    int n = epoll_wait(_epfd, events, 256, timeoutMs);
+    for (int i = 0; i < n; ++i) {
+        Conn& c = _conns[events[i].data.u32];
+        if (events[i].events & EPOLLOUT)
+            flush(c);
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            readFrom(c);
+    }
+}
+
+void LoadGenerator::readFrom(Conn& c) {
+    char buf[16384];
+    while (!c.dead) {
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n == 0) {
+            drop(c);
+            return;
+        }
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                drop(c);
+            break;
+        }
+        c.in.append(buf, static_cast<size_t>(n));
+    }
+    size_t start = 0, end;
+    while ((end = c.in.find("\r\n", start)) != std::string::npos) {
+        handleLine(c, c.in.substr(start, end - start));
+        start = end + 2;
+    }
+    c.in.erase(0, start);
+}
+
+void LoadGenerator::handleLine(Conn& c, const std::string& line) {
+    size_t mark = line.find(" :b ");
+    if (mark != std::string::npos && line.find(" PRIVMSG ") != std::string::npos) {
+        if (_measuring) {
+            unsigned long long sentAt = std::strtoull(line.c_str() + mark + 4, NULL, 10);
+            _latency.record(monotonicNanos() - sentAt);
+            ++_totals.delivered;
+        }
+        return;
+    }
+    if (line.find(" :User registered") != std::string::npos) {
+        c.registered = true;
+        return;
+    }
+    // ":localhost NNN ..." with NNN >= 400 is an error numeric.
+    size_t sp = line.find(' ');
+    if (sp != std::string::npos && line.size() > sp + 4 && line[sp + 1] >= '4' && line[sp + 1] <= '5'
+        && std::isdigit(static_cast<unsigned char>(line[sp + 2])) && _measuring)
+        ++_totals.errors;
+}
+
+// Open-loop pacing: operations are issued on a fixed schedule whether or
+// not the server keeps up, so queueing delay shows up in the latency.
+void LoadGenerator::drive() {
+    unsigned long long start = monotonicNanos();
+    unsigned long long measureFrom = start + static_cast<unsigned long long>(_o.warmup * 1e9);
+    unsigned long long stop = measureFrom + static_cast<unsigned long long>(_o.duration * 1e9);
+    double interval = 1e9 / _o.rate;
+    double issued = 0;
+    size_t next = 0;
+    while (true) {
+        unsigned long long now = monotonicNanos();
+        if (now >= stop)
+            break;
+        if (!_measuring && now >= measureFrom) {
+            _measuring = true;
+            _measuredNs = now;
+        }
+        double due = static_cast<double>(now - start) / interval;
+        while (issued < due) {
+            Conn& c = _conns[next];
+            next = (next + 1) % _conns.size();
+            if (!c.dead)
+                issue(c);
+            issued += 1;
+        }
+        poll(1);
+    }
+    // Let in-flight lines land so the tail is not cut off.
+    unsigned long long drain = monotonicNanos() + 200000000ULL;
+    while (monotonicNanos() < drain)
+        poll(10);
+    _measuredNs = stop - _measuredNs;
+    _peakRss = readPeakRssKb(_o.serverPid);
+}
+
+void LoadGenerator::report() {
+    double seconds = toSeconds(_measuredNs);
+    double opsPerSec = _totals.ops / seconds;
+    double deliveredPerSec = _totals.delivered / seconds;
+    unsigned long long p50 = _latency.percentile(0.5) / 1000;
+    unsigned long long p99 = _latency.percentile(0.99) / 1000;
+    unsigned long long p999 = _latency.percentile(0.999) / 1000;
+    unsigned long long maxUs = _latency.max() / 1000;
+
+    std::cout << "ops/s " << opsPerSec << ", privmsg sent " << _totals.sent
+              << ", delivered " << _totals.delivered << " (" << deliveredPerSec << "/s)\n"
+              << "delivery latency us: p50 " << p50 << " p99 " << p99 << " p999 " << p999
+              << " max " << maxUs << "\n"
+              << "errors " << _totals.errors << ", server peak rss " << _peakRss << " kB\n";
+    if (_o.csv.empty())
+        return;
+    std::ifstream existing(_o.csv.c_str());
+    bool header = !existing.good() || existing.peek() == std::ifstream::traits_type::eof();
+    existing.close();
+    std::ofstream csv(_o.csv.c_str(), std::ios::app);
+    if (!csv)
+        throw std::runtime_error("cannot write " + _o.csv);
+    if (header)
+        csv << "time,label,clients,channels,joins,dist,mix,rate,duration,ops_per_sec,"
+               "privmsg_sent,delivered,delivered_per_sec,p50_us,p99_us,p999_us,max_us,errors,rss_kb\n";
+    time_t now = time(NULL);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+    csv << std::fixed << std::setprecision(1);
+    csv << stamp << "," << _o.label << "," << _o.clients << "," << _o.channels << ","
+        << _o.joins << "," << _o.dist << "," << _o.mix[0] << ":" << _o.mix[1] << ":"
+        << _o.mix[2] << ":" << _o.mix[3] << "," << _o.rate << "," << _o.duration << ","
+        << opsPerSec << "," << _totals.sent << "," << _totals.delivered << ","
+        << deliveredPerSec << "," << p50 << "," << p99 << "," << p999 << "," << maxUs << ","
+        << _totals.errors << "," << _peakRss << "\n";
+}
+
+} // namespace
+
+int main(int ac, char** av) {
+    try {
+        Options o = parseOptions(ac, av);
+        LoadGenerator gen(o);
+        gen.connectAll();
+        gen.waitRegistered();
+        gen.joinInitial();
+        gen.drive();
+        gen.report();
+    } catch (const std::exception& e) {
+        std::cerr << "loadgen: " << e.what() << std::endl;
+        usage();
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,389 @@
+// Microbenchmarks for the per-line hot paths, linked against the same
+// objects as ircserv. Every case is warmed up, calibrated so one sample
+// lasts about --sample-ms, then sampled --reps times; the median and the
+// median absolute deviation (MAD) of ns/op are reported, which stay stable
+// when a few samples are hit by an interrupt or a context switch.
+//
+//   microbench [--filter TEXT] [--reps N] [--sample-ms MS] [--csv FILE]
+//              [--label TEXT]
+
+#include "Channel.hpp"
+#include "ChannelManager.hpp"
+#include "Client.hpp"
+#include "ClientManager.hpp"
+#include "Histogram.hpp"
+#include "Message.hpp"
+#include "ParsedCommand.hpp"
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Keeps the optimizer from discarding a result or hoisting work out of the
+// timed loop.
+template <typename T>
+inline void keep(const T& value) {
+    __asm__ __volatile__("" : : "r"(&value) : "memory");
+}
+
+class Case {
+public:
+    virtual ~Case() {}
+    virtual const char* name() const = 0;
+    virtual void run(size_t iterations) = 0;
+};
+
+struct Options {
+    std::string filter;
+    int reps;
+    double sampleMs;
+    double warmupMs;
+    std::string csv;
+    std::string label;
+
+    Options() : reps(21), sampleMs(20), warmupMs(200) {}
+};
+
+struct Result {
+    std::string name;
+    double median;      // ns per operation
+    double mad;
+    size_t iterations;  // per sample
+};
+
+int nullFd() {
+    int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error("cannot open /dev/null");
+    return fd;
+}
+
+// Clients that never touch a socket get fds far above any real one, so
+// their destructor's close() is a harmless EBADF.
+const int FAKE_FD_BASE = 1 << 16;
+
+// --- ParsedCommand::parse over a mix of typical lines
+
+class ParseCase : public Case {
+public:
+    ParseCase() {
+        _lines.push_back("PRIVMSG #general :hello everyone, how is it going today?");
+        _lines.push_back(":nick!user@host PRIVMSG #general :a relayed line with a prefix");
+        _lines.push_back("JOIN #a,#b,#c key1,key2");
+        _lines.push_back("MODE #general +ok-l secret alice");
+        _lines.push_back("@time=2024-01-01T00:00:00.000Z;msgid=abc PRIVMSG bob :tagged");
+        _lines.push_back("NICK somebody");
+    }
+    const char* name() const { return "parse/mixed"; }
+    void run(size_t n) {
+        ParsedCommand cmd;
+        for (size_t i = 0; i < n; ++i) {
+            const std::string& line = _lines[i % _lines.size()];
+            cmd.parse(StringView(line));
+            keep(cmd);
+        }
+    }
+
+private:
+    std::vector<std::string> _lines;
+};
+
+// --- Client::appendToRecv + hasCompleteMessage/popMessage, per line
+
+class FramingCase : public Case {
+public:
+    FramingCase() : _client(FAKE_FD_BASE) {
+        for (int i = 0; i < LINES; ++i)
+            _chunk += "PRIVMSG #general :line of moderate length for framing\r\n";
+    }
+    const char* name() const { return "recv/pop-line"; }
+    void run(size_t n) {
+        size_t done = 0;
+        size_t fed = 0;
+        while (done < n) {
+            fed += _client.appendToRecv(_chunk.data() + fed, _chunk.size() - fed);
+            if (fed == _chunk.size())
+                fed = 0;
+            while (_client.hasCompleteMessage()) {
+                StringView line = _client.popMessage();
+                keep(line);
+                ++done;
+            }
+        }
+    }
+
+private:
+    static const int LINES = 16;    // one 1 KB read
+    Client _client;
+    std::string _chunk;
+};
+
+// --- Client::handleClientMessage: lookup, parse and handler dispatch
+
+class DispatchCase : public Case {
+public:
+    DispatchCase(const char* name, const char* line) : _name(name), _line(line),
+            _password("pw"), _clients(_password) {
+        _self = new Client(nullFd());
+        _clients.addClient(_self);
+        feed("PASS pw");
+        feed("NICK bencher");
+        feed("USER bencher 0 * :bench");
+        feed("JOIN #bench");
+        drain();
+    }
+    const char* name() const { return _name; }
+    void run(size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            feed(_line);
+            if (_self->hasPendingOutput())
+                drain();
+        }
+    }
+
+private:
+    const char* _name;
+    const char* _line;
+    std::string _password;
+    ClientManager _clients;
+    ChannelManager _channels;
+    Client* _self;
+
+    void feed(const char* line) {
+        _self->handleClientMessage(StringView(line), &_channels, &_clients);
+    }
+    void drain() {
+        _self->flushSend();
+        _self->clearFlushScheduled();
+    }
+};
+
+// --- ClientManager::getClientByNick with a populated, casemapped index
+
+class NickLookupCase : public Case {
+public:
+    NickLookupCase() : _password("pw"), _clients(_password) {
+        for (int i = 0; i < CLIENTS; ++i) {
+            Client* c = new Client(FAKE_FD_BASE + i);
+            std::ostringstream nick;
+            nick << "User" << i << "[x]";
+            c->setNick(nick.str());
+            _clients.addClient(c);
+            _clients.renameClient(c, "");
+        }
+        // Look names up in another case ([ and { are the same letter), plus
+        // one miss in eight.
+        for (int i = 0; i < CLIENTS; ++i) {
+            std::ostringstream nick;
+            if (i % 8 == 7)
+                nick << "nobody" << i;
+            else
+                nick << "uSER" << (i * 7919) % CLIENTS << "{X}";
+            _queries.push_back(nick.str());
+        }
+    }
+    const char* name() const { return "nick-lookup/10k"; }
+    void run(size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            Client* c = _clients.getClientByNick(StringView(_queries[i % _queries.size()]));
+            keep(c);
+        }
+    }
+
+private:
+    static const int CLIENTS = 10000;
+    std::string _password;
+    ClientManager _clients;
+    std::vector<std::string> _queries;
+};
+
+// --- Channel::broadcast to members whose sockets are socketpairs; one op
+// is one line queued to every member and written out with writev.
+
+class BroadcastCase : public Case {
+public:
+    explicit BroadcastCase(int members) : _members(members), _password("pw"),
+            _clients(_password), _line(":someone!user@host PRIVMSG #bench :a typical channel message\r\n") {
+        std::ostringstream name;
+        name << "broadcast/" << members << "+flush";
+        _name = name.str();
+        bool created = false;
+        _channel = _channels.getOrCreateChannel(StringView("#bench"), created);
+        for (int i = 0; i < members; ++i) {
+            int pair[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0)
+                throw std::runtime_error("socketpair failed (raise ulimit -n?)");
+            fcntl(pair[1], F_SETFL, O_NONBLOCK);
+            Client* c = new Client(pair[0]);
+            _clients.addClient(c);
+            _channel->addMember(c, false);
+            _sinks.push_back(pair[1]);
+        }
+    }
+    ~BroadcastCase() {
+        for (size_t i = 0; i < _sinks.size(); ++i)
+            close(_sinks[i]);
+    }
+    const char* name() const { return _name.c_str(); }
+    void run(size_t n) {
+        char buf[65536];
+        for (size_t i = 0; i < n; ++i) {
+            _channel->broadcast(_line, &_clients);
+            const MemberTable& members = _channel->getMembers();
+            for (size_t m = 0; m < members.size(); ++m) {
+                members.valueAt(m).client->flushSend();
+                members.valueAt(m).client->clearFlushScheduled();
+            }
+            // Empty the sinks every few rounds so the socket buffers never
+            // fill and every flush completes with a single writev.
+            if (i % 32 == 31) {
+                for (size_t s = 0; s < _sinks.size(); ++s) {
+                    while (read(_sinks[s], buf, sizeof(buf)) > 0) {}
+                }
+            }
+        }
+    }
+
+private:
+    int _members;
+    std::string _name;
+    std::string _password;
+    ClientManager _clients;
+    ChannelManager _channels;
+    Channel* _channel;
+    MessageRef _line;
+    std::vector<int> _sinks;
+};
+
+double medianOf(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    if (values.size() % 2)
+        return values[mid];
+    return (values[mid - 1] + values[mid]) / 2;
+}
+
+double elapsedNs(Case& c, size_t iterations) {
+    unsigned long long start = monotonicNanos();
+    c.run(iterations);
+    return static_cast<double>(monotonicNanos() - start);
+}
+
+Result measure(Case& c, const Options& o) {
+    // Warmup doubles the batch until a batch takes a sample's worth of
+    // time, which also settles caches, the allocator and the CPU clock.
+    size_t iterations = 1;
+    double warmed = 0;
+    double took = 0;
+    while (true) {
+        took = elapsedNs(c, iterations);
+        warmed += took;
+        if (took >= o.sampleMs * 1e6 && warmed >= o.warmupMs * 1e6)
+            break;
+        if (took < o.sampleMs * 1e6)
+            iterations *= 2;
+    }
+    std::vector<double> samples;
+    for (int r = 0; r < o.reps; ++r)
+        samples.push_back(elapsedNs(c, iterations) / iterations);
+    Result result;
+    result.name = c.name();
+    result.median = medianOf(samples);
+    std::vector<double> deviations;
+    for (size_t i = 0; i < samples.size(); ++i)
+        deviations.push_back(samples[i] > result.median ? samples[i] - result.median
+                                                       : result.median - samples[i]);
+    result.mad = medianOf(deviations);
+    result.iterations = iterations;
+    return result;
+}
+
+Options parseOptions(int ac, char** av) {
+    Options o;
+    for (int i = 1; i < ac; ++i) {
+        std::string key = av[i];
+        if (i + 1 >= ac)
+            throw std::runtime_error("missing value for " + key);
+        std::string value = av[++i];
+        if (key == "--filter") o.filter = value;
+        else if (key == "--reps") o.reps = std::atoi(value.c_str());
+        else if (key == "--sample-ms") o.sampleMs = std::atof(value.c_str());
+        else if (key == "--warmup-ms") o.warmupMs = std::atof(value.c_str());
+        else if (key == "--csv") o.csv = value;
+        else if (key == "--label") o.label = value;
+        else
+            throw std::runtime_error("unknown option " + key);
+    }
+    if (o.reps < 3 || o.sampleMs <= 0 || o.warmupMs < 0)
+        throw std::runtime_error("need --reps >= 3 and a positive --sample-ms");
+    return o;
+}
+
+} // namespace
+
+int main(int ac, char** av) {
+    try {
+        Options o = parseOptions(ac, av);
+        std::vector<Case*> cases;
+        cases.push_back(new ParseCase());
+        cases.push_back(new FramingCase());
+        cases.push_back(new DispatchCase("dispatch/privmsg-channel", "PRIVMSG #bench :hello"));
+        cases.push_back(new DispatchCase("dispatch/topic-query", "TOPIC #bench"));
+        cases.push_back(new DispatchCase("dispatch/unknown", "FOOBAR x y z"));
+        cases.push_back(new NickLookupCase());
+        cases.push_back(new BroadcastCase(1));
+        cases.push_back(new BroadcastCase(64));
+        cases.push_back(new BroadcastCase(512));
+
+        std::vector<Result> results;
+        std::cout << std::left << std::setw(28) << "case" << std::right << std::setw(12) << "ns/op"
+                  << std::setw(10) << "MAD" << std::setw(8) << "MAD%" << std::setw(14) << "ops/s"
+                  << std::setw(12) << "iters" << "\n";
+        for (size_t i = 0; i < cases.size(); ++i) {
+            if (!o.filter.empty() && std::string(cases[i]->name()).find(o.filter) == std::string::npos)
+                continue;
+            Result r = measure(*cases[i], o);
+            results.push_back(r);
+            std::cout << std::left << std::setw(28) << r.name << std::right << std::fixed
+                      << std::setprecision(1) << std::setw(12) << r.median << std::setw(10) << r.mad
+                      << std::setw(7) << (r.median > 0 ? 100 * r.mad / r.median : 0) << "%"
+                      << std::setprecision(0) << std::setw(14) << (r.median > 0 ? 1e9 / r.median : 0)
+                      << std::setw(12) << r.iterations << std::endl;
+        }
+        for (size_t i = 0; i < cases.size(); ++i)
+            delete cases[i];
+
+        if (!o.csv.empty()) {
+            std::ifstream existing(o.csv.c_str());
+            bool header = !existing.good() || existing.peek() == std::ifstream::traits_type::eof();
+            existing.close();
+            std::ofstream csv(o.csv.c_str(), std::ios::app);
+            if (!csv)
+                throw std::runtime_error("cannot write " + o.csv);
+            if (header)
+                csv << "label,case,median_ns,mad_ns,iterations,reps\n";
+            csv << std::fixed << std::setprecision(1);
+            for (size_t i = 0; i < results.size(); ++i)
+                csv << o.label << "," << results[i].name << "," << results[i].median << "," << results[i].mad << ","
+                    << results[i].iterations << "," << o.reps << "\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "microbench: " << e.what() << std::endl;
+        std::cerr << "usage: microbench [--filter TEXT] [--reps N] [--sample-ms MS]"
+                     " [--warmup-ms MS] [--csv FILE] [--label TEXT]" << std::endl;
+        return 1;
+    }
+    return 0;
+}
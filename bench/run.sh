@@ -0,0 +1,25 @@
+#!/bin/sh
+# Starts a fresh ircserv on a spare port, runs the load generator against it
+# and appends the result to bench/results.csv. Extra arguments go to loadgen,
+# e.g. `bench/run.sh --clients 500 --dist zipf` or
+# `make bench BENCH_ARGS="--clients 500 --dist zipf"`.
+set -e
+cd "$(dirname "$0")/.."
+
+PORT=${BENCH_PORT:-6790}
+CSV=${BENCH_CSV:-bench/results.csv}
+LABEL=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+if ! git diff --quiet HEAD 2>/dev/null; then
+    LABEL="$LABEL-dirty"
+fi
+
+# Flood control is off unless asked for: the load is meant to reach the server.
+IRCSERV_LOG_LEVEL=${IRCSERV_LOG_LEVEL:-warn} IRCSERV_FLOOD_RATE=${IRCSERV_FLOOD_RATE:-0} \
+    ./ircserv "$PORT" benchpw &
+SERVER=$!
+trap 'kill -INT $SERVER 2>/dev/null; wait $SERVER 2>/dev/null' EXIT
+sleep 0.3
+
+./bench/loadgen --port "$PORT" --password benchpw --server-pid "$SERVER" \
+    --label "$LABEL" --csv "$CSV" "$@"
+echo "appended to $CSV"
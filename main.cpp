@@ -16,6 +16,7 @@
 #include "Server.hpp"
 #include "ClientManager.hpp"
 #include "ChannelManager.hpp"
+#include "Log.hpp"
 
 
 int main(int ac, char **av)
@@ -23,14 +24,17 @@ int main(int ac, char **av)
 	try
 	{
 		ServerConfig config = parse_arguments(ac, av);
-		server my_server(config.port, config.password);
+		Log::start(config.log_level);
+		server my_server(config);
 		my_server.setup();
 		my_server.run();
 	}
 	catch (const std::exception& e)
 	{
+		Log::stop();
 		std::cerr << "Error: " << e.what() << std::endl;
 		return 1;
 	}
+	Log::stop();
 	return 0;
 }
@@ -1,7 +1,23 @@
 #include "parser.hpp"
+#include "ClientManager.hpp"
+#include "Client.hpp"
 #include <cctype>
 #include <cstdlib>
 #include <stdexcept>
+#include <sys/socket.h>
+
+// Reads a positive integer tunable from the environment, or returns def.
+static long env_number(const char *name, long def, long min, long max)
+{
+	const char *value = std::getenv(name);
+	if (!value || !*value)
+		return def;
+	char *end = NULL;
+	long n = std::strtol(value, &end, 10);
+	if (*end != '\0' || n < min || n > max)
+		throw std::runtime_error(std::string("Invalid value for ") + name);
+	return n;
+}
 
 
 ServerConfig parse_arguments(int ac, char **av)
@@ -33,6 +49,33 @@ ServerConfig parse_arguments(int ac, char **av)
     {
         throw std::runtime_error("Password cannot be empty");
     }
+	// Tunables are read from the environment so the command line stays
+	// `./ircserv <port> <password>`.
+	const char *backend = std::getenv("IRCSERV_BACKEND");
+	config.backend = backend ? backend : "epoll";
+	if (config.backend != "epoll" && config.backend != "poll")
+		throw std::runtime_error("IRCSERV_BACKEND must be 'epoll' or 'poll'");
+	config.sendq = env_number("IRCSERV_SENDQ", ClientManager::DEFAULT_SENDQ, 512, 1L << 30);
+	config.line_max = env_number("IRCSERV_LINE_MAX", Client::MAX_LINE, 64, 65536);
+	config.recvq = env_number("IRCSERV_RECVQ", Client::RECV_BUFFER_SIZE, 128, 1L << 20);
+	if (config.recvq <= config.line_max)
+		throw std::runtime_error("IRCSERV_RECVQ must be larger than IRCSERV_LINE_MAX");
+	config.listen_backlog = env_number("IRCSERV_BACKLOG", SOMAXCONN, 1, 65535);
+	config.accept_batch = env_number("IRCSERV_ACCEPT_BATCH", 64, 1, 65536);
+	config.threads = env_number("IRCSERV_THREADS", 1, 1, 256);
+	config.metrics_port = env_number("IRCSERV_METRICS_PORT", 0, 0, 65535);
+	if (config.metrics_port != 0 && (config.metrics_port < 1024 || config.metrics_port == port_num))
+		throw std::runtime_error("IRCSERV_METRICS_PORT must be 0 or a free port between 1024 and 65535");
+	config.flood_rate = env_number("IRCSERV_FLOOD_RATE", 10, 0, 1000000);
+	config.flood_burst = env_number("IRCSERV_FLOOD_BURST", 20, 1, 1000000);
+	config.line_budget = env_number("IRCSERV_LINE_BUDGET", 16, 1, 65536);
+	config.register_timeout = env_number("IRCSERV_REGISTER_TIMEOUT", 30, 0, 86400);
+	config.ping_interval = env_number("IRCSERV_PING_INTERVAL", 120, 0, 86400);
+	config.ping_timeout = env_number("IRCSERV_PING_TIMEOUT", 60, 1, 86400);
+	const char *log_level = std::getenv("IRCSERV_LOG_LEVEL");
+	config.log_level = Log::INFO;
+	if (log_level && *log_level && !Log::parseLevel(log_level, config.log_level))
+		throw std::runtime_error("IRCSERV_LOG_LEVEL must be off, error, warn, info or debug");
 	return config;
 }
 
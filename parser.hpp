@@ -5,11 +5,27 @@
 #include <string>
 #include <vector>
 #include <iostream>
+#include "Log.hpp"
 
 struct ServerConfig
 {
 	int port;
 	std::string password;
+	std::string backend;	// event loop backend: "epoll" (default) or "poll"
+	size_t sendq;			// per-client output queue limit in bytes
+	size_t recvq;			// per-client input buffer size in bytes
+	size_t line_max;		// longest accepted line, CRLF included
+	int listen_backlog;		// listen() backlog
+	size_t accept_batch;	// most connections accepted per loop iteration
+	int threads;			// worker threads, each with its own listener
+	int metrics_port;		// loopback Prometheus endpoint, 0 = disabled
+	unsigned flood_rate;	// flood tokens refilled per second, 0 = no limit
+	unsigned flood_burst;	// flood bucket size in tokens
+	unsigned line_budget;	// most lines run per connection per loop iteration
+	unsigned register_timeout;	// seconds to complete PASS/NICK/USER, 0 = none
+	unsigned ping_interval;	// idle seconds before a PING, 0 = no keepalive
+	unsigned ping_timeout;	// seconds to answer it
+	Log::Level log_level;	// most verbose level written
 };
 
 ServerConfig parse_arguments(int ac, char **av);
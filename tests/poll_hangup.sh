@@ -0,0 +1,43 @@
+#!/bin/bash
+# A client held back by flood control hangs up with lines still queued.
+# With the poll backend the server must not spin on the hangup while the
+# connection is held: it stays idle until the flood timer lets the held
+# lines run, then notices the close. Run by `make check`.
+set -e
+cd "$(dirname "$0")/.."
+
+PORT=${TEST_PORT:-6795}
+LOG=$(mktemp)
+IRCSERV_BACKEND=poll IRCSERV_FLOOD_RATE=1 IRCSERV_FLOOD_BURST=4 \
+    ./ircserv "$PORT" testpw > "$LOG" 2>&1 &
+SERVER=$!
+trap 'kill -INT $SERVER 2>/dev/null; wait $SERVER 2>/dev/null; rm -f "$LOG"' EXIT
+sleep 0.3
+
+# Register and queue more PINGs than the bucket allows. Read what comes
+# back, then close: the next PONG the server writes is answered with a
+# reset, so poll() reports POLLHUP/POLLERR while the rest is held.
+exec 3<>"/dev/tcp/127.0.0.1/$PORT"
+printf 'PASS testpw\r\nNICK held\r\nUSER held 0 * :held\r\n' >&3
+for i in 1 2 3 4 5 6 7 8 9 10; do printf 'PING :%d\r\n' "$i" >&3; done
+timeout 0.6 cat <&3 > /dev/null || true
+exec 3<&-
+
+ticks() { awk '{ print $14 + $15 }' "/proc/$SERVER/stat"; }
+before=$(ticks)
+sleep 2
+after=$(ticks)
+if [ $((after - before)) -gt 20 ]; then
+    echo "FAIL: server used $((after - before)) CPU ticks in 2 s while the client was held"
+    exit 1
+fi
+
+for i in $(seq 100); do
+    grep -q "Client quit" "$LOG" && break
+    sleep 0.1
+done
+if ! grep -q "Client quit" "$LOG"; then
+    echo "FAIL: the held connection was never closed"
+    exit 1
+fi
+echo "ok: poll backend stays idle while a held client hangs up"